@@ -0,0 +1,166 @@
+#include <broadphase.hpp>
+#include <collision.hpp>
+#include <ecsManager.hpp>
+#include <transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+class Timer {
+    std::chrono::high_resolution_clock::time_point m_start = std::chrono::high_resolution_clock::now();
+
+public:
+    double millis() const {
+        auto elapsed = std::chrono::high_resolution_clock::now() - m_start;
+        return std::chrono::duration<double, std::milli>(elapsed).count();
+    }
+};
+
+class Report {
+    struct Measurement {
+        std::string m_name;
+        size_t m_colliders;
+        std::vector<std::pair<std::string, double>> m_values;
+    };
+
+    std::vector<Measurement> m_measurements;
+
+public:
+    void add(const std::string& name, size_t colliders, double millis, std::vector<std::pair<std::string, double>> extra = {}) {
+        std::vector<std::pair<std::string, double>> values { { "ms", millis } };
+        values.insert(values.end(), extra.begin(), extra.end());
+
+        std::cerr << std::left << std::setw(28) << name << std::right << std::setw(10) << colliders
+                  << std::fixed << std::setprecision(3) << std::setw(14) << millis << " ms" << std::endl;
+
+        m_measurements.push_back({ name, colliders, std::move(values) });
+    }
+
+    void write(std::ostream& out) const {
+        out << "{\n  \"benchmark\": \"mge_bench_collision\",\n  \"results\": [\n";
+
+        for (size_t i = 0; i < m_measurements.size(); i++) {
+            const auto& measurement = m_measurements[i];
+            out << "    { \"name\": \"" << measurement.m_name << "\", \"colliders\": " << measurement.m_colliders;
+            for (const auto& [ key, value ] : measurement.m_values)
+                out << ", \"" << key << "\": " << std::setprecision(6) << std::defaultfloat << value;
+            out << " }" << (i + 1 < m_measurements.size() ? "," : "") << "\n";
+        }
+
+        out << "  ]\n}" << std::endl;
+    }
+};
+
+// the asteroids demo's density, 4'000 spheres in a 1'000 unit cube, however many there are
+struct World {
+    mge::ecs::ECSManager m_ecs;
+    mge::ecs::TransformSystem m_transforms;
+    mge::ecs::CollisionSystem m_collisions;
+    std::vector<mge::ecs::Entity> m_entities;
+    std::vector<glm::vec3> m_velocities;
+
+    World(size_t count, std::mt19937& rng) {
+        m_ecs.addSystem("Transform", &m_transforms);
+        m_ecs.addSystem("Collision", &m_collisions);
+
+        float halfSize = 500.f * std::cbrt(static_cast<float>(count) / 4'000.f);
+        std::uniform_real_distribution<float> position { -halfSize, halfSize };
+        std::uniform_real_distribution<float> velocity { -0.5f, 0.5f };
+        std::uniform_real_distribution<float> radius { 1.f, 5.f };
+
+        for (size_t i = 0; i < count; i++) {
+            auto entity = m_ecs.makeEntity();
+
+            auto transform = m_transforms.addComponent(entity);
+            transform->setPosition({ position(rng), position(rng), position(rng) });
+
+            auto collision = m_collisions.addComponent(entity);
+            collision->r_transform = transform;
+            collision->setCollider(mge::ecs::SphereCollider(radius(rng)));
+
+            m_entities.push_back(entity);
+            m_velocities.push_back({ velocity(rng), velocity(rng), velocity(rng) });
+        }
+    }
+
+    void move() {
+        for (size_t i = 0; i < m_entities.size(); i++) {
+            auto transform = m_transforms.getComponent(m_entities[i]);
+            transform->setPosition(transform->getPosition() + m_velocities[i]);
+        }
+    }
+};
+
+constexpr int STEPS = 8;
+
+// the mean time of a collision step, with everything moving a little between them
+void benchmarkStep(Report& report, const std::string& name, size_t count, mge::ecs::Broadphase* broadphase) {
+    std::mt19937 rng { 1234 };
+    World world { count, rng };
+    world.m_collisions.r_broadphase = broadphase;
+
+    auto tree = dynamic_cast<mge::ecs::DynamicAABBTree*>(broadphase);
+    auto sweep = dynamic_cast<mge::ecs::SweepAndPrune*>(broadphase);
+
+    // the first step builds whatever the broadphase keeps, which isn't what's being measured
+    world.m_collisions.getCollisionEvents();
+
+    double total = 0.0;
+    size_t events = 0, moved = 0, changed = 0;
+
+    for (int step = 0; step < STEPS; step++) {
+        world.move();
+
+        std::pmr::monotonic_buffer_resource memory;
+
+        Timer timer;
+        events += world.m_collisions.getCollisionEvents(&memory).size();
+        total += timer.millis();
+
+        if (tree) moved += tree->getMovedCount();
+        if (sweep) changed += sweep->getAddedPairs().size() + sweep->getRemovedPairs().size();
+    }
+
+    std::vector<std::pair<std::string, double>> extra { { "events", static_cast<double>(events) / STEPS } };
+    if (tree) {
+        extra.push_back({ "moved", static_cast<double>(moved) / STEPS });
+        extra.push_back({ "height", static_cast<double>(tree->getHeight()) });
+    }
+    if (sweep) extra.push_back({ "changed_pairs", static_cast<double>(changed) / STEPS });
+
+    report.add(name, count, total / STEPS, std::move(extra));
+}
+
+}
+
+int main() {
+    Report report;
+
+    for (size_t count : { 4'000, 50'000, 200'000 }) {
+        benchmarkStep(report, "collision/bspt", count, nullptr);
+
+        mge::ecs::DynamicAABBTree tree;
+        benchmarkStep(report, "collision/aabb_tree", count, &tree);
+
+        mge::ecs::SweepAndPrune sweep;
+        benchmarkStep(report, "collision/sweep_and_prune", count, &sweep);
+
+        // the spheres are up to 10 across
+        mge::ecs::UniformGrid grid { 10.f };
+        benchmarkStep(report, "collision/uniform_grid", count, &grid);
+    }
+
+    report.write(std::cout);
+
+    return 0;
+}
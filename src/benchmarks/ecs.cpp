@@ -0,0 +1,580 @@
+#include <ecsManager.hpp>
+#include <spatialSorter.hpp>
+#include <transformBatch.hpp>
+
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Headless ECS benchmarks, written to stdout as JSON so runs can be compared across commits:
+ *
+ *     { "benchmark": "mge_bench_ecs", "results": [ { "name": "iterate/multi", "entities": 1000, "ms": ..., ... } ] }
+ *
+ * "ms" is the mean time of one run of the case and "ns_per_op" divides that by the number of entities it
+ * touches. Progress goes to stderr.
+ */
+
+namespace {
+
+// split in two, to compare joining systems against archetype storage
+struct PositionComponent : public mge::ecs::Component {
+    float m_position[3];
+};
+
+struct VelocityComponent : public mge::ecs::Component {
+    float m_velocity[3];
+};
+
+// the storage mge::ecs::System used before the sparse set, kept here to compare against
+template<typename Component>
+class MapSystem {
+public:
+    std::unordered_map<mge::ecs::Entity, Component> m_components;
+
+    Component* addComponent(const mge::ecs::Entity& entity) {
+        auto result = &m_components[entity];
+        result->m_entity = entity;
+        return result;
+    }
+
+    Component* getComponent(const mge::ecs::Entity& entity) {
+        auto it = m_components.find(entity);
+        return it == m_components.end() ? nullptr : &it->second;
+    }
+
+    void removeComponent(const mge::ecs::Entity& entity) { m_components.erase(entity); }
+};
+
+class Timer {
+    std::chrono::high_resolution_clock::time_point m_start = std::chrono::high_resolution_clock::now();
+
+public:
+    double millis() const {
+        auto elapsed = std::chrono::high_resolution_clock::now() - m_start;
+        return std::chrono::duration<double, std::milli>(elapsed).count();
+    }
+};
+
+// counts last level cache misses with perf where the kernel allows it, and reports -1 everywhere else
+class CacheMissCounter {
+    int m_fd = -1;
+
+public:
+    CacheMissCounter() {
+#ifdef __linux__
+        perf_event_attr attr {};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    ~CacheMissCounter() {
+#ifdef __linux__
+        if (m_fd != -1) close(m_fd);
+#endif
+    }
+
+    void start() {
+#ifdef __linux__
+        if (m_fd == -1) return;
+        ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    long long stop() {
+#ifdef __linux__
+        if (m_fd == -1) return -1;
+        ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count;
+        if (read(m_fd, &count, sizeof(count)) == sizeof(count)) return count;
+#endif
+        return -1;
+    }
+};
+
+// keeps the optimiser from discarding benchmark loops
+volatile float g_sink;
+
+class Report {
+    struct Measurement {
+        std::string m_name;
+        size_t m_entities;
+        std::vector<std::pair<std::string, double>> m_values;
+    };
+
+    std::vector<Measurement> m_measurements;
+
+public:
+    // records the mean time of one run, and that time per entity the run touched
+    void add(const std::string& name, size_t entities, double millis, size_t operations,
+             std::vector<std::pair<std::string, double>> extra = {}) {
+        std::vector<std::pair<std::string, double>> values {
+            { "ms", millis },
+            { "ns_per_op", millis * 1'000'000.0 / static_cast<double>(std::max<size_t>(1, operations)) },
+        };
+        values.insert(values.end(), extra.begin(), extra.end());
+
+        std::cerr << std::left << std::setw(28) << name << std::right << std::setw(10) << entities
+                  << std::fixed << std::setprecision(3) << std::setw(14) << millis << " ms" << std::endl;
+
+        m_measurements.push_back({ name, entities, std::move(values) });
+    }
+
+    void write(std::ostream& out) const {
+        out << "{\n  \"benchmark\": \"mge_bench_ecs\",\n  \"results\": [\n";
+
+        for (size_t i = 0; i < m_measurements.size(); i++) {
+            const auto& measurement = m_measurements[i];
+            out << "    { \"name\": \"" << measurement.m_name << "\", \"entities\": " << measurement.m_entities;
+            for (const auto& [ key, value ] : measurement.m_values)
+                out << ", \"" << key << "\": " << std::setprecision(6) << std::defaultfloat << value;
+            out << " }" << (i + 1 < m_measurements.size() ? "," : "") << "\n";
+        }
+
+        out << "  ]\n}" << std::endl;
+    }
+};
+
+void integrate(PositionComponent& position, const VelocityComponent& velocity) {
+    for (int i = 0; i < 3; i++) position.m_position[i] += velocity.m_velocity[i] * 0.016f;
+}
+
+PositionComponent makePosition(const mge::ecs::Entity& entity) {
+    PositionComponent result;
+    result.m_entity = entity;
+    result.m_position[0] = result.m_position[1] = result.m_position[2] = static_cast<float>(entity.m_index);
+    return result;
+}
+
+VelocityComponent makeVelocity(const mge::ecs::Entity& entity) {
+    VelocityComponent result;
+    result.m_entity = entity;
+    result.m_velocity[0] = result.m_velocity[1] = result.m_velocity[2] = 1.f;
+    return result;
+}
+
+// every entity has a position, every other one a velocity as well, so joins skip half of what they visit
+struct World {
+    mge::ecs::ECSManager m_ecs;
+    mge::ecs::System<PositionComponent> m_positions;
+    mge::ecs::System<VelocityComponent> m_velocities;
+    std::vector<mge::ecs::Entity> m_entities;
+
+    World() {
+        m_ecs.addSystem("Position", &m_positions);
+        m_ecs.addSystem("Velocity", &m_velocities);
+    }
+
+    mge::ecs::Entity spawn() {
+        auto entity = m_ecs.makeEntity();
+        *m_positions.addComponent(entity) = makePosition(entity);
+        if (entity.m_index % 2 == 0) *m_velocities.addComponent(entity) = makeVelocity(entity);
+        return entity;
+    }
+
+    void populate(size_t count) {
+        m_entities.reserve(count);
+        for (size_t i = 0; i < count; i++) m_entities.push_back(spawn());
+    }
+};
+
+// enough runs of a case that small entity counts aren't just timer noise
+int runsFor(size_t count, size_t budget = 10'000'000) {
+    return static_cast<int>(std::max<size_t>(1, budget / count));
+}
+
+// the mean time of func(world) over fresh worlds, setup(world) isn't timed
+template<typename Setup, typename Func>
+double timeFresh(size_t count, Setup&& setup, Func&& func) {
+    int runs = runsFor(count, 1'000'000);
+    double total = 0.0;
+
+    for (int i = 0; i < runs; i++) {
+        World world;
+        setup(world);
+
+        Timer timer;
+        func(world);
+        total += timer.millis();
+    }
+
+    return total / runs;
+}
+
+void benchmarkCreate(Report& report, size_t count) {
+    double millis = timeFresh(count, [](World&) {}, [&](World& world) { world.populate(count); });
+    report.add("create", count, millis, count);
+}
+
+// each round destroys a tenth of the entities at random and spawns as many again into the recycled indices
+void benchmarkChurn(Report& report, size_t count, std::mt19937& rng) {
+    constexpr int ROUNDS = 10;
+    size_t perRound = std::max<size_t>(1, count / 10);
+
+    double millis = timeFresh(count, [&](World& world) { world.populate(count); }, [&](World& world) {
+        for (int round = 0; round < ROUNDS; round++) {
+            for (size_t i = 0; i < perRound; i++) {
+                size_t victim = rng() % world.m_entities.size();
+                world.m_ecs.destroyEntity(world.m_entities[victim]);
+                world.m_entities[victim] = world.m_entities.back();
+                world.m_entities.pop_back();
+            }
+
+            for (size_t i = 0; i < perRound; i++) world.m_entities.push_back(world.spawn());
+        }
+    });
+
+    report.add("churn", count, millis / ROUNDS, perRound * 2);
+}
+
+void benchmarkIterate(Report& report, size_t count) {
+    World world;
+    world.populate(count);
+    int runs = runsFor(count);
+
+    {
+        Timer timer;
+        for (int i = 0; i < runs; i++)
+            for (auto [ entity, position ] : world.m_ecs.view<PositionComponent>())
+                position.m_position[0] += 0.016f;
+        report.add("iterate/single", count, timer.millis() / runs, count);
+    }
+
+    {
+        Timer timer;
+        for (int i = 0; i < runs; i++)
+            for (auto [ entity, position, velocity ] : world.m_ecs.view<PositionComponent, const VelocityComponent>())
+                integrate(position, velocity);
+        report.add("iterate/multi", count, timer.millis() / runs, count);
+    }
+}
+
+// the multi component case again, with both components stored together in one archetype
+void benchmarkIterateArchetype(Report& report, size_t count) {
+    mge::ecs::ECSManager ecs;
+
+    for (size_t i = 0; i < count; i++) {
+        auto entity = ecs.makeEntity();
+        ecs.m_archetypes.add(entity, makePosition(entity));
+        if (entity.m_index % 2 == 0) ecs.m_archetypes.add(entity, makeVelocity(entity));
+    }
+
+    int runs = runsFor(count);
+
+    Timer timer;
+    for (int i = 0; i < runs; i++)
+        ecs.m_archetypes.each<PositionComponent, VelocityComponent>([](const mge::ecs::Entity&, PositionComponent& position, VelocityComponent& velocity) {
+            integrate(position, velocity);
+        });
+    report.add("iterate/multi_archetype", count, timer.millis() / runs, count);
+}
+
+void benchmarkGet(Report& report, size_t count, std::mt19937& rng) {
+    World world;
+    world.populate(count);
+
+    std::vector<mge::ecs::Entity> shuffled = world.m_entities;
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    int runs = runsFor(count, 1'000'000);
+
+    Timer timer;
+    float sum = 0.f;
+    for (int i = 0; i < runs; i++)
+        for (const auto& entity : shuffled) sum += world.m_positions.getComponent(entity)->m_position[0];
+    g_sink = sum;
+    report.add("get/random", count, timer.millis() / runs, count);
+}
+
+// the storage systems used before the sparse set, for comparison
+void benchmarkUnorderedMap(Report& report, size_t count, std::mt19937& rng) {
+    // the same entities and components as World
+    MapSystem<PositionComponent> positions;
+    MapSystem<VelocityComponent> velocities;
+    std::vector<mge::ecs::Entity> entities;
+
+    for (size_t i = 0; i < count; i++) {
+        mge::ecs::Entity entity { static_cast<uint32_t>(i), 0 };
+        *positions.addComponent(entity) = makePosition(entity);
+        if (entity.m_index % 2 == 0) *velocities.addComponent(entity) = makeVelocity(entity);
+        entities.push_back(entity);
+    }
+
+    std::shuffle(entities.begin(), entities.end(), rng);
+
+    {
+        // joined the same way a view does it, walking the smaller system and looking up the other
+        int runs = runsFor(count);
+        Timer timer;
+        for (int i = 0; i < runs; i++)
+            for (auto& [ entity, velocity ] : velocities.m_components)
+                if (auto position = positions.getComponent(entity)) integrate(*position, velocity);
+        report.add("iterate/multi_unordered_map", count, timer.millis() / runs, count);
+    }
+
+    {
+        int runs = runsFor(count, 1'000'000);
+        Timer timer;
+        float sum = 0.f;
+        for (int i = 0; i < runs; i++)
+            for (const auto& entity : entities) sum += positions.getComponent(entity)->m_position[0];
+        g_sink = sum;
+        report.add("get/random_unordered_map", count, timer.millis() / runs, count);
+    }
+}
+
+void benchmarkSpawn(Report& report, size_t count) {
+    double templateMillis = timeFresh(count, [](World& world) {
+        world.m_ecs.addTemplate("Bench", [&world](mge::ecs::ECSManager&) { return world.spawn(); });
+    }, [&](World& world) {
+        for (size_t i = 0; i < count; i++) world.m_ecs.makeEntityFromTemplate("Bench");
+    });
+    report.add("spawn/template", count, templateMillis, count);
+
+    mge::ecs::Prefab prefab;
+    prefab.add(PositionComponent {}).add(VelocityComponent {});
+
+    double prefabMillis = timeFresh(count, [](World&) {}, [&](World& world) {
+        world.m_ecs.spawnBatch(prefab, count, [&](mge::ecs::ECSManager&, const mge::ecs::Entity& entity, size_t) {
+            *world.m_positions.getComponent(entity) = makePosition(entity);
+        });
+    });
+    report.add("spawn/prefab", count, prefabMillis, count);
+}
+
+void benchmarkDestroy(Report& report, size_t count, std::mt19937& rng) {
+    auto setup = [&](World& world) {
+        world.populate(count);
+        std::shuffle(world.m_entities.begin(), world.m_entities.end(), rng);
+    };
+
+    double single = timeFresh(count, setup, [](World& world) {
+        for (const auto& entity : world.m_entities) world.m_ecs.destroyEntity(entity);
+    });
+    report.add("destroy/entity", count, single, count);
+
+    double batch = timeFresh(count, setup, [](World& world) { world.m_ecs.destroyEntities(world.m_entities); });
+    report.add("destroy/batch", count, batch, count);
+}
+
+/**
+ * Entities are spawned in a random order around a cube, then visited cell by cell through a uniform grid the
+ * way a broadphase would, reading each one's position and velocity. That visits the packed arrays in random
+ * order until SpatialSorter has put them in Morton order, which the grid order mostly agrees with.
+ */
+void benchmarkSpatialSort(Report& report, size_t count, std::mt19937& rng) {
+    mge::ecs::ECSManager ecs;
+    mge::ecs::System<PositionComponent> positions;
+    mge::ecs::System<VelocityComponent> velocities;
+    ecs.addSystem("Position", &positions);
+    ecs.addSystem("Velocity", &velocities);
+
+    constexpr float EXTENT = 1'000.f;
+    constexpr int CELLS = 32;
+    std::uniform_real_distribution<float> coordinate(0.f, EXTENT);
+
+    std::vector<std::pair<int, mge::ecs::Entity>> gridOrder;
+
+    for (size_t i = 0; i < count; i++) {
+        auto entity = ecs.makeEntity();
+
+        auto position = positions.addComponent(entity);
+        for (int axis = 0; axis < 3; axis++) position->m_position[axis] = coordinate(rng);
+        *velocities.addComponent(entity) = makeVelocity(entity);
+
+        int cell = 0;
+        for (int axis = 0; axis < 3; axis++)
+            cell = cell * CELLS + std::min(CELLS - 1, static_cast<int>(position->m_position[axis] / EXTENT * CELLS));
+        gridOrder.push_back({ cell, entity });
+    }
+
+    std::sort(gridOrder.begin(), gridOrder.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<mge::ecs::Entity> visits;
+    for (auto& [ cell, entity ] : gridOrder) visits.push_back(entity);
+
+    CacheMissCounter counter;
+    int runs = runsFor(count);
+
+    auto gather = [&](double& misses) {
+        counter.start();
+        Timer timer;
+
+        float sum = 0.f;
+        for (int i = 0; i < runs; i++)
+            for (const auto& entity : visits)
+                sum += positions.readComponent(entity)->m_position[0] * velocities.readComponent(entity)->m_velocity[0];
+        g_sink = sum;
+
+        double millis = timer.millis() / runs;
+        long long total = counter.stop();
+        misses = total < 0 ? -1.0 : static_cast<double>(total) / runs;
+        return millis;
+    };
+
+    double missesBefore, missesAfter;
+    double before = gather(missesBefore);
+
+    mge::ecs::SpatialSorter sorter([&](const mge::ecs::Entity& entity, float (&position)[3]) {
+        auto component = positions.readComponent(entity);
+        if (!component) return false;
+        for (int axis = 0; axis < 3; axis++) position[axis] = component->m_position[axis];
+        return true;
+    });
+    sorter.addSystem(&positions).addSystem(&velocities);
+
+    // the budget the asteroids demo spends per frame
+    size_t frames = 1;
+    while (!sorter.step(1'024)) frames++;
+
+    double after = gather(missesAfter);
+
+    // cache misses are -1 where perf counters aren't available
+    report.add("gather/unsorted", count, before, count, { { "cache_misses", missesBefore } });
+    report.add("gather/morton_sorted", count, after, count, {
+        { "cache_misses", missesAfter },
+        { "sort_frames", static_cast<double>(frames) },
+    });
+}
+
+// TransformComponent's data without glm, the matrix column major
+struct BenchTransform {
+    float m_position[3], m_rotation[4], m_scale[3];
+    float m_matrix[16], m_basis[9];
+};
+
+void multiply(const float (&a)[16], const float (&b)[16], float (&result)[16]) {
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++) {
+            float sum = 0.f;
+            for (int k = 0; k < 4; k++) sum += a[k * 4 + r] * b[c * 4 + k];
+            result[c * 4 + r] = sum;
+        }
+}
+
+// what TransformComponent::updateMatrix does, translate * scale * rotation as full 4x4 matrices, then the basis
+void composeTransform(BenchTransform& transform) {
+    auto [ x, y, z, w ] = transform.m_rotation;
+
+    float translation[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0,
+        transform.m_position[0], transform.m_position[1], transform.m_position[2], 1 };
+    float scale[16] = { transform.m_scale[0], 0, 0, 0, 0, transform.m_scale[1], 0, 0, 0, 0, transform.m_scale[2], 0, 0, 0, 0, 1 };
+    float rotation[16] = {
+        1 - 2 * (y * y + z * z), 2 * (x * y + w * z), 2 * (x * z - w * y), 0,
+        2 * (x * y - w * z), 1 - 2 * (x * x + z * z), 2 * (y * z + w * x), 0,
+        2 * (x * z + w * y), 2 * (y * z - w * x), 1 - 2 * (x * x + y * y), 0,
+        0, 0, 0, 1,
+    };
+
+    float scaled[16];
+    multiply(translation, scale, scaled);
+    multiply(scaled, rotation, transform.m_matrix);
+
+    for (int c = 0; c < 3; c++) {
+        const float* column = &transform.m_matrix[c * 4];
+        float length = std::sqrt(column[0] * column[0] + column[1] * column[1] + column[2] * column[2]);
+        for (int r = 0; r < 3; r++) transform.m_basis[c * 3 + r] = column[r] / length;
+    }
+}
+
+/**
+ * Every transform has moved, so every matrix and basis is rebuilt, either one transform at a time the way the
+ * lazy getters do it or through a TransformBatch the way TransformSystem::updateMatrices does, including copying
+ * in and out of the batch.
+ */
+void benchmarkTransforms(Report& report, size_t count, std::mt19937& rng) {
+    std::uniform_real_distribution<float> value(-1.f, 1.f);
+
+    std::vector<BenchTransform> transforms(count);
+    for (auto& transform : transforms) {
+        for (auto& position : transform.m_position) position = value(rng) * 100.f;
+        for (auto& rotation : transform.m_rotation) rotation = value(rng);
+        for (auto& scale : transform.m_scale) scale = 1.f + value(rng) * 0.5f;
+    }
+
+    int runs = runsFor(count, 1'000'000);
+    float sum = 0.f;
+
+    Timer perObjectTimer;
+    for (int i = 0; i < runs; i++)
+        for (auto& transform : transforms) {
+            composeTransform(transform);
+            sum += transform.m_matrix[0];
+        }
+    report.add("transform/per_object", count, perObjectTimer.millis() / runs, count);
+
+    mge::ecs::TransformBatch batch;
+
+    Timer batchedTimer;
+    for (int i = 0; i < runs; i++) {
+        batch.resize(count);
+        for (size_t t = 0; t < count; t++)
+            batch.set(t, transforms[t].m_position, transforms[t].m_rotation, transforms[t].m_scale);
+
+        batch.compose(0, count);
+
+        for (size_t t = 0; t < count; t++) {
+            auto& transform = transforms[t];
+            for (int c = 0; c < 3; c++) {
+                for (int r = 0; r < 3; r++) {
+                    transform.m_matrix[c * 4 + r] = batch.m_columns[c * 3 + r][t];
+                    transform.m_basis[c * 3 + r] = batch.m_basis[c * 3 + r][t];
+                }
+                transform.m_matrix[c * 4 + 3] = 0.f;
+            }
+            for (int r = 0; r < 3; r++) transform.m_matrix[12 + r] = transform.m_position[r];
+            transform.m_matrix[15] = 1.f;
+            sum += transform.m_matrix[0];
+        }
+    }
+    report.add("transform/batched", count, batchedTimer.millis() / runs, count, {
+        { "lanes", static_cast<double>(mge::ecs::TransformBatch::LANES) },
+    });
+
+    g_sink = sum;
+}
+
+}
+
+int main() {
+    std::mt19937 rng { 1234 };
+    Report report;
+
+    for (size_t count : { 1'000, 10'000, 100'000, 1'000'000 }) {
+        benchmarkCreate(report, count);
+        benchmarkChurn(report, count, rng);
+        benchmarkIterate(report, count);
+        benchmarkIterateArchetype(report, count);
+        benchmarkGet(report, count, rng);
+        benchmarkUnorderedMap(report, count, rng);
+        benchmarkSpawn(report, count);
+        benchmarkDestroy(report, count, rng);
+        benchmarkSpatialSort(report, count, rng);
+        benchmarkTransforms(report, count, rng);
+    }
+
+    report.write(std::cout);
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <jobSystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+namespace {
+
+class Timer {
+    std::chrono::high_resolution_clock::time_point m_start = std::chrono::high_resolution_clock::now();
+
+public:
+    double millis() const {
+        auto elapsed = std::chrono::high_resolution_clock::now() - m_start;
+        return std::chrono::duration<double, std::milli>(elapsed).count();
+    }
+};
+
+// keeps the optimiser from discarding benchmark loops
+volatile float g_sink;
+
+constexpr size_t JOB_COUNT = 100'000;
+constexpr size_t WORK_ITEMS = 4'000'000;
+
+// the average cost of submitting and running one empty job
+double emptyJobNanos(mge::JobSystem& jobs) {
+    mge::TaskGroup group;
+
+    Timer timer;
+    for (size_t i = 0; i < JOB_COUNT; i++) jobs.submit(group, []{});
+    jobs.wait(group);
+
+    return timer.millis() * 1'000'000.0 / JOB_COUNT;
+}
+
+// the average cost of a parallelFor job that does nothing
+double emptyParallelForNanos(mge::JobSystem& jobs) {
+    Timer timer;
+    jobs.parallelFor(0, JOB_COUNT, 1, [](size_t, size_t) {});
+    return timer.millis() * 1'000'000.0 / JOB_COUNT;
+}
+
+double workMillis(mge::JobSystem& jobs, std::vector<float>& values, size_t grainSize) {
+    Timer timer;
+
+    jobs.parallelFor(0, values.size(), grainSize, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            float value = values[i];
+            for (int j = 0; j < 32; j++) value = std::sqrt(value * value + 1.f);
+            values[i] = value;
+        }
+    });
+
+    g_sink = values[values.size() / 2];
+    return timer.millis();
+}
+
+}
+
+int main() {
+    size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<float> values(WORK_ITEMS, 1.f);
+
+    std::cout << std::setw(8) << "threads"
+              << std::setw(16) << "submit ns/job"
+              << std::setw(16) << "for ns/job"
+              << std::setw(14) << "work ms"
+              << std::setw(10) << "speedup"
+              << std::endl;
+
+    double serialMillis = 0.0;
+
+    for (size_t threads = 1; threads <= maxThreads; threads++) {
+        // the thread that waits runs jobs too, so it counts as one of them
+        mge::JobSystem jobs(threads - 1);
+
+        // warm up the workers and the queues' storage
+        workMillis(jobs, values, 4096);
+
+        double submit = emptyJobNanos(jobs);
+        double parallelFor = emptyParallelForNanos(jobs);
+        double work = workMillis(jobs, values, 4096);
+
+        if (threads == 1) serialMillis = work;
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << std::setw(8) << threads
+                  << std::setw(16) << submit
+                  << std::setw(16) << parallelFor
+                  << std::setw(14) << work
+                  << std::setw(10) << serialMillis / work
+                  << std::endl;
+    }
+
+    return 0;
+}
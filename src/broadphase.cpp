@@ -0,0 +1,670 @@
+#include <broadphase.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace mge::ecs {
+
+int32_t DynamicAABBTree::allocateNode() {
+    if (m_free == NULL_NODE) {
+        m_nodes.emplace_back();
+        m_free = static_cast<int32_t>(m_nodes.size() - 1);
+    }
+
+    int32_t node = m_free;
+    m_free = m_nodes[node].m_parent;
+    m_nodes[node] = Node {};
+    m_nodes[node].m_height = 0;
+    return node;
+}
+
+void DynamicAABBTree::freeNode(int32_t node) {
+    m_nodes[node].m_parent = m_free;
+    m_nodes[node].m_height = -1;
+    m_free = node;
+}
+
+void DynamicAABBTree::insertLeaf(int32_t leaf) {
+    if (m_root == NULL_NODE) {
+        m_root = leaf;
+        m_nodes[leaf].m_parent = NULL_NODE;
+        return;
+    }
+
+    // walk down to the best sibling, going by the increase in surface area each choice costs
+    AABB box = m_nodes[leaf].m_box;
+    int32_t index = m_root;
+
+    while (!m_nodes[index].isLeaf()) {
+        const Node& node = m_nodes[index];
+
+        float area = node.m_box.getSurfaceArea();
+        float combinedArea = node.m_box.merge(box).getSurfaceArea();
+
+        // making a new parent for this node and the leaf
+        float cost = 2.f * combinedArea;
+
+        // every ancestor below this one grows by at least this much if we carry on down
+        float inheritedCost = 2.f * (combinedArea - area);
+
+        auto descendCost = [&](int32_t child) {
+            const AABB& childBox = m_nodes[child].m_box;
+            float grownArea = childBox.merge(box).getSurfaceArea();
+            if (m_nodes[child].isLeaf()) return grownArea + inheritedCost;
+            return grownArea - childBox.getSurfaceArea() + inheritedCost;
+        };
+
+        float leftCost = descendCost(node.m_left);
+        float rightCost = descendCost(node.m_right);
+
+        if (cost < leftCost && cost < rightCost) break;
+
+        index = leftCost < rightCost ? node.m_left : node.m_right;
+    }
+
+    int32_t sibling = index;
+    int32_t oldParent = m_nodes[sibling].m_parent;
+
+    int32_t newParent = allocateNode();
+    m_nodes[newParent].m_parent = oldParent;
+    m_nodes[newParent].m_box = m_nodes[sibling].m_box.merge(box);
+    m_nodes[newParent].m_height = m_nodes[sibling].m_height + 1;
+    m_nodes[newParent].m_left = sibling;
+    m_nodes[newParent].m_right = leaf;
+
+    if (oldParent == NULL_NODE) {
+        m_root = newParent;
+    } else if (m_nodes[oldParent].m_left == sibling) {
+        m_nodes[oldParent].m_left = newParent;
+    } else {
+        m_nodes[oldParent].m_right = newParent;
+    }
+
+    m_nodes[sibling].m_parent = newParent;
+    m_nodes[leaf].m_parent = newParent;
+
+    fixUpwards(newParent);
+}
+
+void DynamicAABBTree::removeLeaf(int32_t leaf) {
+    if (leaf == m_root) {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    // the leaf's parent goes too, and its sibling takes the parent's place
+    int32_t parent = m_nodes[leaf].m_parent;
+    int32_t grandParent = m_nodes[parent].m_parent;
+    int32_t sibling = m_nodes[parent].m_left == leaf ? m_nodes[parent].m_right : m_nodes[parent].m_left;
+
+    m_nodes[sibling].m_parent = grandParent;
+    freeNode(parent);
+
+    if (grandParent == NULL_NODE) {
+        m_root = sibling;
+        return;
+    }
+
+    if (m_nodes[grandParent].m_left == parent) m_nodes[grandParent].m_left = sibling;
+    else m_nodes[grandParent].m_right = sibling;
+
+    fixUpwards(grandParent);
+}
+
+void DynamicAABBTree::fixUpwards(int32_t index) {
+    while (index != NULL_NODE) {
+        index = balance(index);
+
+        Node& node = m_nodes[index];
+        const Node& left = m_nodes[node.m_left];
+        const Node& right = m_nodes[node.m_right];
+
+        node.m_height = 1 + std::max(left.m_height, right.m_height);
+        node.m_box = left.m_box.merge(right.m_box);
+
+        index = node.m_parent;
+    }
+}
+
+int32_t DynamicAABBTree::balance(int32_t iA) {
+    Node& A = m_nodes[iA];
+    if (A.isLeaf() || A.m_height < 2) return iA;
+
+    int32_t iB = A.m_left, iC = A.m_right;
+    Node& B = m_nodes[iB];
+    Node& C = m_nodes[iC];
+
+    int32_t difference = C.m_height - B.m_height;
+
+    // C is too tall, it takes A's place and A takes whichever of C's children is shorter
+    if (difference > 1) {
+        int32_t iF = C.m_left, iG = C.m_right;
+        Node& F = m_nodes[iF];
+        Node& G = m_nodes[iG];
+
+        C.m_left = iA;
+        C.m_parent = A.m_parent;
+        A.m_parent = iC;
+
+        if (C.m_parent == NULL_NODE) m_root = iC;
+        else if (m_nodes[C.m_parent].m_left == iA) m_nodes[C.m_parent].m_left = iC;
+        else m_nodes[C.m_parent].m_right = iC;
+
+        if (F.m_height > G.m_height) {
+            C.m_right = iF;
+            A.m_right = iG;
+            G.m_parent = iA;
+            A.m_box = B.m_box.merge(G.m_box);
+            C.m_box = A.m_box.merge(F.m_box);
+            A.m_height = 1 + std::max(B.m_height, G.m_height);
+            C.m_height = 1 + std::max(A.m_height, F.m_height);
+        } else {
+            C.m_right = iG;
+            A.m_right = iF;
+            F.m_parent = iA;
+            A.m_box = B.m_box.merge(F.m_box);
+            C.m_box = A.m_box.merge(G.m_box);
+            A.m_height = 1 + std::max(B.m_height, F.m_height);
+            C.m_height = 1 + std::max(A.m_height, G.m_height);
+        }
+
+        return iC;
+    }
+
+    // the same the other way round, B is too tall
+    if (difference < -1) {
+        int32_t iD = B.m_left, iE = B.m_right;
+        Node& D = m_nodes[iD];
+        Node& E = m_nodes[iE];
+
+        B.m_left = iA;
+        B.m_parent = A.m_parent;
+        A.m_parent = iB;
+
+        if (B.m_parent == NULL_NODE) m_root = iB;
+        else if (m_nodes[B.m_parent].m_left == iA) m_nodes[B.m_parent].m_left = iB;
+        else m_nodes[B.m_parent].m_right = iB;
+
+        if (D.m_height > E.m_height) {
+            B.m_right = iD;
+            A.m_left = iE;
+            E.m_parent = iA;
+            A.m_box = C.m_box.merge(E.m_box);
+            B.m_box = A.m_box.merge(D.m_box);
+            A.m_height = 1 + std::max(C.m_height, E.m_height);
+            B.m_height = 1 + std::max(A.m_height, D.m_height);
+        } else {
+            B.m_right = iE;
+            A.m_left = iD;
+            D.m_parent = iA;
+            A.m_box = C.m_box.merge(D.m_box);
+            B.m_box = A.m_box.merge(E.m_box);
+            A.m_height = 1 + std::max(C.m_height, D.m_height);
+            B.m_height = 1 + std::max(A.m_height, E.m_height);
+        }
+
+        return iB;
+    }
+
+    return iA;
+}
+
+bool DynamicAABBTree::descend(NodePair pair, std::pmr::vector<NodePair>& pairs) const {
+    const Node& a = m_nodes[pair.m_a];
+
+    // a subtree against itself is each half against itself, and the halves against each other
+    if (pair.m_a == pair.m_b) {
+        if (a.isLeaf()) return true;
+        pairs.push_back({ a.m_left, a.m_left });
+        pairs.push_back({ a.m_right, a.m_right });
+        pairs.push_back({ a.m_left, a.m_right });
+        return true;
+    }
+
+    const Node& b = m_nodes[pair.m_b];
+    if (!a.m_box.checkIntersection(b.m_box)) return true;
+    if (a.isLeaf() && b.isLeaf()) return false;
+
+    // split whichever is taller, so the two sides stay about the same size on the way down
+    if (b.isLeaf() || (!a.isLeaf() && a.m_height >= b.m_height)) {
+        pairs.push_back({ a.m_left, pair.m_b });
+        pairs.push_back({ a.m_right, pair.m_b });
+    } else {
+        pairs.push_back({ pair.m_a, b.m_left });
+        pairs.push_back({ pair.m_a, b.m_right });
+    }
+
+    return true;
+}
+
+void DynamicAABBTree::collide(NodePair pair, std::pmr::vector<CollisionPair>& pairs) const {
+    // deep enough for any tree that's anywhere near balanced without touching the heap
+    NodePair buffer[256];
+    std::pmr::monotonic_buffer_resource memory { buffer, sizeof(buffer) };
+    std::pmr::vector<NodePair> stack { &memory };
+    stack.reserve(std::size(buffer) / 2);
+
+    stack.push_back(pair);
+    while (!stack.empty()) {
+        NodePair next = stack.back();
+        stack.pop_back();
+
+        if (descend(next, stack)) continue;
+
+        // two leaves whose fat AABBs overlap, which doesn't mean the colliders' own AABBs do
+        uint32_t a = m_nodes[next.m_a].m_slot, b = m_nodes[next.m_b].m_slot;
+        if (r_boxes[a].checkIntersection(r_boxes[b]))
+            pairs.push_back({ std::min(a, b), std::max(a, b) });
+    }
+}
+
+void DynamicAABBTree::findPairs(CollisionSystem& system, std::pmr::vector<CollisionPair>& pairs) {
+    auto& components = system.m_components;
+    uint32_t count = static_cast<uint32_t>(components.size());
+
+    m_stamp++;
+    m_movedCount = 0;
+    r_boxes = system.m_cache.m_boxes.data();
+
+    for (uint32_t slot = 0; slot < count; slot++) {
+        auto& comp = components[slot];
+        const AABB& box = r_boxes[slot];
+
+        int32_t proxy = comp.m_broadphaseProxy;
+        bool valid = proxy >= 0 && proxy < static_cast<int32_t>(m_nodes.size())
+                  && m_nodes[proxy].m_height == 0 && m_nodes[proxy].m_entity == comp.m_entity;
+
+        if (!valid) {
+            proxy = comp.m_broadphaseProxy = allocateNode();
+            m_nodes[proxy].m_entity = comp.m_entity;
+            m_nodes[proxy].m_box = box.expand(m_margin);
+            insertLeaf(proxy);
+            m_leafCount++;
+            m_movedCount++;
+        } else if (!m_nodes[proxy].m_box.contains(box)) {
+            removeLeaf(proxy);
+            m_nodes[proxy].m_box = box.expand(m_margin);
+            insertLeaf(proxy);
+            m_movedCount++;
+        }
+
+        m_nodes[proxy].m_slot = slot;
+        m_nodes[proxy].m_stamp = m_stamp;
+    }
+
+    // anything that wasn't seen has had its component removed, removing leaves only ever frees nodes so the
+    // indices stay put while this runs
+    if (m_leafCount > count)
+    for (int32_t node = 0; node < static_cast<int32_t>(m_nodes.size()); node++) {
+        if (m_nodes[node].m_height != 0 || m_nodes[node].m_stamp == m_stamp) continue;
+
+        removeLeaf(node);
+        freeNode(node);
+        m_leafCount--;
+    }
+
+    if (m_root == NULL_NODE) return;
+
+    JobSystem* jobSystem = system.r_jobSystem;
+    if (!jobSystem) {
+        collide({ m_root, m_root }, pairs);
+        return;
+    }
+
+    // expands the top of the traversal until there's enough of it to share out
+    constexpr size_t TASKS = 256;
+    auto memory = pairs.get_allocator().resource();
+
+    std::pmr::vector<NodePair> tasks { memory }, expanded { memory };
+    tasks.push_back({ m_root, m_root });
+
+    while (tasks.size() < TASKS) {
+        bool descended = false;
+
+        expanded.clear();
+        for (const auto& task : tasks) {
+            if (descend(task, expanded)) descended = true;
+            else expanded.push_back(task);
+        }
+
+        std::swap(tasks, expanded);
+        if (!descended) break;
+    }
+
+    std::pmr::vector<std::pmr::vector<CollisionPair>> taskPairs { tasks.size(), memory };
+    jobSystem->parallelFor(0, tasks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) collide(tasks[i], taskPairs[i]);
+    });
+
+    for (const auto& task : taskPairs)
+        pairs.insert(pairs.end(), task.begin(), task.end());
+}
+
+
+uint32_t SweepAndPrune::allocateProxy() {
+    if (m_free == NULL_PROXY) {
+        m_proxies.emplace_back();
+        m_free = static_cast<int32_t>(m_proxies.size() - 1);
+    }
+
+    uint32_t proxy = m_free;
+    m_free = m_proxies[proxy].m_next;
+    m_proxies[proxy] = Proxy {};
+    m_proxies[proxy].m_used = true;
+    return proxy;
+}
+
+void SweepAndPrune::freeProxy(uint32_t proxy) {
+    m_proxies[proxy].m_used = false;
+    m_proxies[proxy].m_next = m_free;
+    m_free = proxy;
+}
+
+void SweepAndPrune::addPair(uint32_t a, uint32_t b) {
+    // the AABBs are already where they'll be at the end of the step, so a pair that's added is never taken out
+    // again by a later swap in the same one
+    if (!m_proxies[a].m_box.checkIntersection(m_proxies[b].m_box)) return;
+
+    if (m_pairs.insert(pairKey(a, b)).second)
+        m_added.push_back({ m_proxies[a].m_entity, m_proxies[b].m_entity });
+}
+
+void SweepAndPrune::removePair(uint32_t a, uint32_t b) {
+    if (m_pairs.erase(pairKey(a, b)))
+        m_removed.push_back({ m_proxies[a].m_entity, m_proxies[b].m_entity });
+}
+
+void SweepAndPrune::sortAxis(int axis, const std::vector<uint32_t>& added) {
+    auto& endpoints = m_endpoints[axis];
+
+    std::erase_if(endpoints, [&](const Endpoint& endpoint) { return !m_proxies[endpoint.m_proxy].m_used; });
+
+    for (auto& endpoint : endpoints) {
+        const AABB& box = m_proxies[endpoint.m_proxy].m_box;
+        endpoint.m_value = endpoint.m_isMax ? maxOf(box, axis) : minOf(box, axis);
+    }
+
+    // new ones start off past the end, where they don't overlap anything, and are sorted in from there
+    for (uint32_t proxy : added) {
+        const AABB& box = m_proxies[proxy].m_box;
+        endpoints.push_back({ minOf(box, axis), proxy, false });
+        endpoints.push_back({ maxOf(box, axis), proxy, true });
+    }
+
+    for (size_t i = 1; i < endpoints.size(); i++) {
+        Endpoint endpoint = endpoints[i];
+
+        size_t j = i;
+        for (; j > 0 && endpoint.precedes(endpoints[j - 1]); j--) {
+            const Endpoint& other = endpoints[j - 1];
+
+            // a start moving back past an end might be a new overlap, an end moving back past a start ends one
+            if (!endpoint.m_isMax && other.m_isMax) addPair(endpoint.m_proxy, other.m_proxy);
+            else if (endpoint.m_isMax && !other.m_isMax) removePair(endpoint.m_proxy, other.m_proxy);
+
+            endpoints[j] = other;
+        }
+
+        endpoints[j] = endpoint;
+    }
+}
+
+void SweepAndPrune::rebuild() {
+    for (int axis = 0; axis < 3; axis++) {
+        auto& endpoints = m_endpoints[axis];
+        endpoints.clear();
+
+        for (uint32_t proxy = 0; proxy < m_proxies.size(); proxy++) {
+            if (!m_proxies[proxy].m_used) continue;
+
+            const AABB& box = m_proxies[proxy].m_box;
+            endpoints.push_back({ minOf(box, axis), proxy, false });
+            endpoints.push_back({ maxOf(box, axis), proxy, true });
+        }
+
+        std::sort(endpoints.begin(), endpoints.end(), [](const Endpoint& a, const Endpoint& b) { return a.precedes(b); });
+    }
+
+    // sweep along x, testing each AABB against the ones it starts inside of
+    auto& pairs = m_rebuiltPairs;
+    auto& open = m_open;
+    pairs.clear();
+    open.clear();
+
+    for (const auto& endpoint : m_endpoints[0]) {
+        if (endpoint.m_isMax) {
+            auto it = std::find(open.begin(), open.end(), endpoint.m_proxy);
+            *it = open.back();
+            open.pop_back();
+            continue;
+        }
+
+        const AABB& box = m_proxies[endpoint.m_proxy].m_box;
+        for (uint32_t other : open)
+            if (box.checkIntersection(m_proxies[other].m_box)) pairs.insert(pairKey(endpoint.m_proxy, other));
+
+        open.push_back(endpoint.m_proxy);
+    }
+
+    auto entities = [&](uint64_t key) {
+        return EntityPair { m_proxies[key >> 32].m_entity, m_proxies[key & 0xffffffff].m_entity };
+    };
+
+    for (uint64_t key : m_pairs) if (!pairs.contains(key)) m_removed.push_back(entities(key));
+    for (uint64_t key : pairs) if (!m_pairs.contains(key)) m_added.push_back(entities(key));
+
+    std::swap(m_pairs, pairs);
+    pairs.clear();
+}
+
+void SweepAndPrune::findPairs(CollisionSystem& system, std::pmr::vector<CollisionPair>& pairs) {
+    auto& components = system.m_components;
+    uint32_t count = static_cast<uint32_t>(components.size());
+
+    m_stamp++;
+    m_added.clear();
+    m_removed.clear();
+
+    auto& added = m_addedProxies;
+    added.clear();
+
+    for (uint32_t slot = 0; slot < count; slot++) {
+        auto& comp = components[slot];
+
+        int32_t proxy = comp.m_broadphaseProxy;
+        bool valid = proxy >= 0 && proxy < static_cast<int32_t>(m_proxies.size())
+                  && m_proxies[proxy].m_used && m_proxies[proxy].m_entity == comp.m_entity;
+
+        if (!valid) {
+            proxy = comp.m_broadphaseProxy = allocateProxy();
+            m_proxies[proxy].m_entity = comp.m_entity;
+            added.push_back(proxy);
+        }
+
+        m_proxies[proxy].m_box = comp.getAABB();
+        m_proxies[proxy].m_slot = slot;
+        m_proxies[proxy].m_stamp = m_stamp;
+    }
+
+    // anything that wasn't seen has had its component removed, its pairs go with it
+    bool freed = false;
+    for (uint32_t proxy = 0; proxy < m_proxies.size(); proxy++) {
+        if (!m_proxies[proxy].m_used || m_proxies[proxy].m_stamp == m_stamp) continue;
+
+        freeProxy(proxy);
+        freed = true;
+    }
+
+    if (freed) std::erase_if(m_pairs, [&](uint64_t key) {
+        const Proxy& a = m_proxies[key >> 32];
+        const Proxy& b = m_proxies[key & 0xffffffff];
+        if (a.m_used && b.m_used) return false;
+
+        m_removed.push_back({ a.m_entity, b.m_entity });
+        return true;
+    });
+
+    if (added.size() > MAX_SORTED_IN) {
+        rebuild();
+    } else {
+        for (int axis = 0; axis < 3; axis++) sortAxis(axis, added);
+    }
+
+    pairs.reserve(pairs.size() + m_pairs.size());
+    for (uint64_t key : m_pairs) {
+        uint32_t a = m_proxies[key >> 32].m_slot, b = m_proxies[key & 0xffffffff].m_slot;
+        pairs.push_back({ std::min(a, b), std::max(a, b) });
+    }
+}
+
+
+int32_t UniformGrid::cellOf(float position) const {
+    return wrapCell(static_cast<int32_t>(std::floor(position / m_size)));
+}
+
+int32_t UniformGrid::wrapCell(int32_t cell) const {
+    if (!m_cellsPerPeriod) return cell;
+    return (cell % m_cellsPerPeriod + m_cellsPerPeriod) % m_cellsPerPeriod;
+}
+
+uint32_t UniformGrid::bucketOf(const int32_t cell[3]) const {
+    uint32_t hash = static_cast<uint32_t>(cell[0]) * 73'856'093u
+                  ^ static_cast<uint32_t>(cell[1]) * 19'349'663u
+                  ^ static_cast<uint32_t>(cell[2]) * 83'492'791u;
+
+    return hash & m_bucketMask;
+}
+
+void UniformGrid::testPair(const Entry& a, const Entry& b, std::pmr::vector<CollisionPair>& pairs) const {
+    glm::vec3 offset { 0.f };
+    AABB box = b.m_box;
+
+    if (m_cellsPerPeriod) {
+        // whichever copy of b is nearest a
+        float centreA[3] = { a.m_box.m_minX + a.m_box.m_maxX, a.m_box.m_minY + a.m_box.m_maxY, a.m_box.m_minZ + a.m_box.m_maxZ };
+        float centreB[3] = { b.m_box.m_minX + b.m_box.m_maxX, b.m_box.m_minY + b.m_box.m_maxY, b.m_box.m_minZ + b.m_box.m_maxZ };
+
+        for (int axis = 0; axis < 3; axis++)
+            offset[axis] = -m_period * std::round((centreB[axis] - centreA[axis]) * 0.5f / m_period);
+
+        box.m_minX += offset.x; box.m_maxX += offset.x;
+        box.m_minY += offset.y; box.m_maxY += offset.y;
+        box.m_minZ += offset.z; box.m_maxZ += offset.z;
+    }
+
+    if (!a.m_box.checkIntersection(box)) return;
+
+    if (a.m_slot < b.m_slot) pairs.push_back({ a.m_slot, b.m_slot, offset });
+    else pairs.push_back({ b.m_slot, a.m_slot, -offset });
+}
+
+void UniformGrid::scan(uint32_t index, std::pmr::vector<CollisionPair>& pairs) const {
+    // the neighbours after this cell, going through them in x, then y, then z order
+    static constexpr int32_t HALF_NEIGHBOURHOOD[13][3] = {
+        {  1,  0,  0 },
+        { -1,  1,  0 }, {  0,  1,  0 }, {  1,  1,  0 },
+        { -1, -1,  1 }, {  0, -1,  1 }, {  1, -1,  1 },
+        { -1,  0,  1 }, {  0,  0,  1 }, {  1,  0,  1 },
+        { -1,  1,  1 }, {  0,  1,  1 }, {  1,  1,  1 },
+    };
+
+    const Entry& entry = m_entries[index];
+
+    auto sameCell = [](const int32_t a[3], const int32_t b[3]) { return a[0] == b[0] && a[1] == b[1] && a[2] == b[2]; };
+
+    // other cells can share the bucket, so each entry's cell is checked
+    for (uint32_t other = index + 1; other < m_bucketStarts[entry.m_bucket + 1]; other++)
+        if (sameCell(m_entries[other].m_cell, entry.m_cell)) testPair(entry, m_entries[other], pairs);
+
+    for (const auto& direction : HALF_NEIGHBOURHOOD) {
+        int32_t cell[3];
+        for (int axis = 0; axis < 3; axis++) cell[axis] = wrapCell(entry.m_cell[axis] + direction[axis]);
+
+        uint32_t bucket = bucketOf(cell);
+        for (uint32_t other = m_bucketStarts[bucket]; other < m_bucketStarts[bucket + 1]; other++)
+            if (sameCell(m_entries[other].m_cell, cell)) testPair(entry, m_entries[other], pairs);
+    }
+}
+
+void UniformGrid::findPairs(CollisionSystem& system, std::pmr::vector<CollisionPair>& pairs) {
+    auto& components = system.m_components;
+    uint32_t count = static_cast<uint32_t>(components.size());
+    JobSystem* jobSystem = system.r_jobSystem;
+
+    constexpr size_t GRAIN_SIZE = 1'024;
+    auto forEach = [&](size_t end, auto&& func) {
+        if (jobSystem) jobSystem->parallelFor(0, end, GRAIN_SIZE, func);
+        else func(0, end);
+    };
+
+    m_binned.resize(count);
+    forEach(count, [&](size_t begin, size_t end) {
+        for (size_t slot = begin; slot < end; slot++) {
+            m_binned[slot].m_box = components[slot].getAABB();
+            m_binned[slot].m_slot = static_cast<uint32_t>(slot);
+        }
+    });
+
+    // cells have to be at least as big as every AABB, so that any two that overlap are in neighbouring cells
+    m_size = m_cellSize;
+    for (const auto& entry : m_binned) {
+        const AABB& box = entry.m_box;
+        m_size = std::max({ m_size, box.m_maxX - box.m_minX, box.m_maxY - box.m_minY, box.m_maxZ - box.m_minZ });
+    }
+
+    m_cellsPerPeriod = 0;
+    if (m_period > 0.f) {
+        m_cellsPerPeriod = std::max(3, static_cast<int32_t>(m_period / m_size));
+        m_size = m_period / static_cast<float>(m_cellsPerPeriod);
+    }
+
+    // one bucket per collider or so, and one more at the end so every bucket has an end
+    uint32_t buckets = 1;
+    while (buckets < count) buckets *= 2;
+    m_bucketStarts.assign(buckets + 1, 0);
+    m_bucketMask = buckets - 1;
+
+    forEach(count, [&](size_t begin, size_t end) {
+        for (size_t slot = begin; slot < end; slot++) {
+            Entry& entry = m_binned[slot];
+            const AABB& box = entry.m_box;
+
+            entry.m_cell[0] = cellOf((box.m_minX + box.m_maxX) * 0.5f);
+            entry.m_cell[1] = cellOf((box.m_minY + box.m_maxY) * 0.5f);
+            entry.m_cell[2] = cellOf((box.m_minZ + box.m_maxZ) * 0.5f);
+            entry.m_bucket = bucketOf(entry.m_cell);
+        }
+    });
+
+    // counting sort by bucket, each bucket's start is where the bucket before it ends
+    for (const auto& entry : m_binned) m_bucketStarts[entry.m_bucket + 1]++;
+    for (uint32_t bucket = 0; bucket < buckets; bucket++) m_bucketStarts[bucket + 1] += m_bucketStarts[bucket];
+
+    m_entries.resize(count);
+    for (const auto& entry : m_binned) m_entries[m_bucketStarts[entry.m_bucket]++] = entry;
+
+    // scattering moved every start along to the next bucket's, so move them back
+    for (uint32_t bucket = buckets; bucket > 0; bucket--) m_bucketStarts[bucket] = m_bucketStarts[bucket - 1];
+    m_bucketStarts[0] = 0;
+
+    if (!jobSystem) {
+        for (uint32_t entry = 0; entry < count; entry++) scan(entry, pairs);
+        return;
+    }
+
+    size_t grains = (count + GRAIN_SIZE - 1) / GRAIN_SIZE;
+
+    auto memory = pairs.get_allocator().resource();
+    std::pmr::vector<std::pmr::vector<CollisionPair>> grainPairs { grains, memory };
+    jobSystem->parallelFor(0, grains, 1, [&](size_t begin, size_t end) {
+        for (size_t grain = begin; grain < end; grain++)
+        for (size_t entry = grain * GRAIN_SIZE; entry < std::min<size_t>(count, (grain + 1) * GRAIN_SIZE); entry++)
+            scan(static_cast<uint32_t>(entry), grainPairs[grain]);
+    });
+
+    for (const auto& grain : grainPairs)
+        pairs.insert(pairs.end(), grain.begin(), grain.end());
+}
+
+}
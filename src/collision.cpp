@@ -1,13 +1,10 @@
 #include <collision.hpp>
+#include <broadphase.hpp>
 
-namespace mge::ecs {
+#include <cmath>
+#include <limits>
 
-bool AABB::checkIntersection(const AABB& other) const {
-    bool xIntersection = !(m_maxX < other.m_minX && m_minX > other.m_maxX);
-    bool yIntersection = !(m_maxY < other.m_minY && m_minY > other.m_maxY);
-    bool zIntersection = !(m_maxZ < other.m_minZ && m_minZ > other.m_maxZ);
-    return xIntersection && yIntersection && zIntersection;
-}
+namespace mge::ecs {
 
 bool Collider::checkCollisionAlongDirection(const Collider& other, const glm::vec3& normal, CollisionEvent& event) const {
     glm::vec3 antiNormal = -normal;
@@ -40,7 +37,11 @@ bool Collider::checkCollisionAlongDirection(const Collider& other, const glm::ve
 }
 
 bool Collider::checkCollisionSAT(const Collider& other, CollisionEvent& event) const {
-    std::vector<glm::vec3> normalsToCheck;
+    // no collider adds more than three normals, so this stays on the stack
+    alignas(glm::vec3) std::byte buffer[8 * sizeof(glm::vec3)];
+    std::pmr::monotonic_buffer_resource memory { buffer, sizeof(buffer) };
+    std::pmr::vector<glm::vec3> normalsToCheck { &memory };
+    normalsToCheck.reserve(6);
 
     addNormalsToVector(normalsToCheck, other);
     other.addNormalsToVector(normalsToCheck, *this);
@@ -61,15 +62,245 @@ bool Collider::checkCollisionSAT(const Collider& other, CollisionEvent& event) c
     return true;
 }
 
+namespace {
+
+// the normal in an event is the way a has to move to get out of b, and the point is halfway through the overlap
+
+// two spheres, or the closest points of two shapes that are rounded by a radius
+bool checkSpheres(const glm::vec3& a, float aRadius, const glm::vec3& b, float bRadius, CollisionEvent& event) {
+    glm::vec3 difference = a - b;
+    float distance2 = glm::dot(difference, difference);
+    float radius = aRadius + bRadius;
+    if (distance2 >= radius * radius) return false;
+
+    // right on top of each other, one way out is as good as another
+    float distance = std::sqrt(distance2);
+    event.m_normal = distance > 0.f ? difference / distance : glm::vec3 { 0.f, 1.f, 0.f };
+    event.m_collisionDepth = radius - distance;
+    event.m_collisionPoint = a - event.m_normal * (aRadius - event.m_collisionDepth * 0.5f);
+    return true;
+}
+
+glm::vec3 closestPointOnSegment(const glm::vec3& point, const glm::vec3& start, const glm::vec3& end) {
+    glm::vec3 direction = end - start;
+    float length2 = glm::dot(direction, direction);
+    float t = length2 > 0.f ? std::clamp(glm::dot(point - start, direction) / length2, 0.f, 1.f) : 0.f;
+    return start + direction * t;
+}
+
+// the closest points between segments p0 to p1 and q0 to q1, from Ericson's Real-Time Collision Detection
+void closestPointsOnSegments(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& q0, const glm::vec3& q1, glm::vec3& p, glm::vec3& q) {
+    constexpr float EPSILON = 1e-6f;
+
+    glm::vec3 d1 = p1 - p0, d2 = q1 - q0, r = p0 - q0;
+    float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+    float s = 0.f, t = 0.f;
+
+    if (a <= EPSILON && e <= EPSILON) {
+        // both are points
+    } else if (a <= EPSILON) {
+        t = std::clamp(f / e, 0.f, 1.f);
+    } else {
+        float c = glm::dot(d1, r);
+
+        if (e <= EPSILON) {
+            s = std::clamp(-c / a, 0.f, 1.f);
+        } else {
+            float b = glm::dot(d1, d2);
+            float denominator = a * e - b * b;
+
+            // parallel segments have no single closest pair, so any s will do
+            if (denominator != 0.f) s = std::clamp((b * f - c * e) / denominator, 0.f, 1.f);
+
+            t = (b * s + f) / e;
+            if (t < 0.f) {
+                t = 0.f;
+                s = std::clamp(-c / a, 0.f, 1.f);
+            } else if (t > 1.f) {
+                t = 1.f;
+                s = std::clamp((b - c) / a, 0.f, 1.f);
+            }
+        }
+    }
+
+    p = p0 + d1 * s;
+    q = q0 + d2 * t;
+}
+
+// an OBB as a centre, unit axes and how far it goes along each
+struct Box {
+    glm::vec3 m_centre;
+    glm::vec3 m_axes[3];
+    float m_halfSizes[3];
+
+    // the corners go along x, then y, then z, so this works for any scale the transform has
+    Box(const OBBCollider& obb) {
+        auto corners = obb.getWorldSpaceCorners();
+        m_centre = (corners[0] + corners[7]) * 0.5f;
+
+        const glm::vec3 edges[3] { corners[1] - corners[0], corners[2] - corners[0], corners[4] - corners[0] };
+        const glm::vec3 fallbacks[3] { { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, 0.f, 1.f } };
+
+        for (int i = 0; i < 3; i++) {
+            float length = glm::length(edges[i]);
+            m_axes[i] = length > 0.f ? edges[i] / length : fallbacks[i];
+            m_halfSizes[i] = length * 0.5f;
+        }
+    }
+
+    float getRadius(const glm::vec3& axis) const {
+        return m_halfSizes[0] * std::abs(glm::dot(m_axes[0], axis))
+             + m_halfSizes[1] * std::abs(glm::dot(m_axes[1], axis))
+             + m_halfSizes[2] * std::abs(glm::dot(m_axes[2], axis));
+    }
+
+    glm::vec3 getSupportPoint(const glm::vec3& direction) const {
+        glm::vec3 point = m_centre;
+        for (int i = 0; i < 3; i++)
+            point += m_axes[i] * (glm::dot(m_axes[i], direction) > 0.f ? m_halfSizes[i] : -m_halfSizes[i]);
+        return point;
+    }
+};
+
+bool checkSphereSphere(const Collider& a, const Collider& b, CollisionEvent& event) {
+    return checkSpheres(a.getPosition(), static_cast<const SphereCollider&>(a).m_radius,
+                        b.getPosition(), static_cast<const SphereCollider&>(b).m_radius, event);
+}
+
+bool checkSphereCapsule(const Collider& a, const Collider& b, CollisionEvent& event) {
+    const auto& capsule = static_cast<const CapsuleCollider&>(b);
+    auto [ top, bottom ] = capsule.getSegment();
+
+    glm::vec3 centre = a.getPosition();
+    return checkSpheres(centre, static_cast<const SphereCollider&>(a).m_radius,
+                        closestPointOnSegment(centre, top, bottom), capsule.m_radius, event);
+}
+
+bool checkCapsuleCapsule(const Collider& a, const Collider& b, CollisionEvent& event) {
+    const auto& aCapsule = static_cast<const CapsuleCollider&>(a);
+    const auto& bCapsule = static_cast<const CapsuleCollider&>(b);
+    auto [ aTop, aBottom ] = aCapsule.getSegment();
+    auto [ bTop, bBottom ] = bCapsule.getSegment();
+
+    glm::vec3 aPoint, bPoint;
+    closestPointsOnSegments(aTop, aBottom, bTop, bBottom, aPoint, bPoint);
+    return checkSpheres(aPoint, aCapsule.m_radius, bPoint, bCapsule.m_radius, event);
+}
+
+bool checkSphereOBB(const Collider& a, const Collider& b, CollisionEvent& event) {
+    float radius = static_cast<const SphereCollider&>(a).m_radius;
+    glm::vec3 centre = a.getPosition();
+    Box box { static_cast<const OBBCollider&>(b) };
+
+    // the sphere's centre in the box's space, and the point in the box closest to it
+    glm::vec3 offset = centre - box.m_centre;
+    float local[3], clamped[3];
+    bool inside = true;
+    for (int i = 0; i < 3; i++) {
+        local[i] = glm::dot(offset, box.m_axes[i]);
+        clamped[i] = std::clamp(local[i], -box.m_halfSizes[i], box.m_halfSizes[i]);
+        inside &= clamped[i] == local[i];
+    }
+
+    if (!inside) {
+        glm::vec3 closest = box.m_centre + box.m_axes[0] * clamped[0] + box.m_axes[1] * clamped[1] + box.m_axes[2] * clamped[2];
+        return checkSpheres(centre, radius, closest, 0.f, event);
+    }
+
+    // the centre is in the box, so it leaves through whichever face is nearest
+    int nearest = 0;
+    float nearestDistance = box.m_halfSizes[0] - std::abs(local[0]);
+    for (int i = 1; i < 3; i++) {
+        float distance = box.m_halfSizes[i] - std::abs(local[i]);
+        if (distance < nearestDistance) {
+            nearest = i;
+            nearestDistance = distance;
+        }
+    }
+
+    event.m_normal = local[nearest] < 0.f ? -box.m_axes[nearest] : box.m_axes[nearest];
+    event.m_collisionDepth = nearestDistance + radius;
+    event.m_collisionPoint = centre + event.m_normal * ((nearestDistance - radius) * 0.5f);
+    return true;
+}
+
+// the 15 axis separating axis test, every face of each box and every pair of their edges
+bool checkOBBOBB(const Collider& a, const Collider& b, CollisionEvent& event) {
+    Box aBox { static_cast<const OBBCollider&>(a) };
+    Box bBox { static_cast<const OBBCollider&>(b) };
+    glm::vec3 between = bBox.m_centre - aBox.m_centre;
+
+    float bestOverlap = std::numeric_limits<float>::max();
+    glm::vec3 bestNormal;
+
+    auto separates = [&](glm::vec3 axis) {
+        // two edges that are parallel don't give an axis, but the faces have already covered it
+        float length2 = glm::dot(axis, axis);
+        if (length2 < 1e-6f) return false;
+        axis /= std::sqrt(length2);
+
+        float distance = glm::dot(between, axis);
+        float overlap = aBox.getRadius(axis) + bBox.getRadius(axis) - std::abs(distance);
+        if (overlap <= 0.f) return true;
+
+        if (overlap < bestOverlap) {
+            bestOverlap = overlap;
+            bestNormal = distance > 0.f ? -axis : axis;
+        }
+
+        return false;
+    };
+
+    for (int i = 0; i < 3; i++) if (separates(aBox.m_axes[i])) return false;
+    for (int i = 0; i < 3; i++) if (separates(bBox.m_axes[i])) return false;
+
+    for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+        if (separates(glm::cross(aBox.m_axes[i], bBox.m_axes[j]))) return false;
+
+    event.m_normal = bestNormal;
+    event.m_collisionDepth = bestOverlap;
+    event.m_collisionPoint = bBox.getSupportPoint(bestNormal) - bestNormal * (bestOverlap * 0.5f);
+    return true;
+}
+
+// nothing closed form for these yet
+bool checkGeneric(const Collider& a, const Collider& b, CollisionEvent& event) {
+    return a.checkCollisionSAT(b, event);
+}
+
+using PairTest = bool (*)(const Collider& a, const Collider& b, CollisionEvent& event);
+
+// runs a test written for the pair the other way round
+template<PairTest test>
+bool checkFlipped(const Collider& a, const Collider& b, CollisionEvent& event) {
+    if (!test(b, a, event)) return false;
+    event.m_normal = -event.m_normal;
+    return true;
+}
+
+constexpr PairTest PAIR_TESTS[Collider::e_typeCount][Collider::e_typeCount] {
+    // sphere                           capsule                 OBB
+    { checkSphereSphere,                checkSphereCapsule,     checkSphereOBB },
+    { checkFlipped<checkSphereCapsule>, checkCapsuleCapsule,    checkGeneric },
+    { checkFlipped<checkSphereOBB>,     checkGeneric,           checkOBBOBB },
+};
+
+}
+
+bool Collider::checkShapes(const Collider& other, CollisionEvent& event) const {
+    return PAIR_TESTS[m_type][other.m_type](*this, other, event);
+}
+
 bool Collider::checkCollision(const Collider& other, CollisionEvent& event) const {
     if (!getAABB().checkIntersection(other.getAABB())) return false;
-    return checkCollisionSAT(other, event);
+    return checkShapes(other, event);
 }
 
-AABB SphereCollider::getAABB() const {
+AABB SphereCollider::computeAABB() const {
     AABB result;
 
-    glm::vec3 position = r_transform->getPosition();
+    glm::vec3 position = getPosition();
 
     result.m_minX = position.x - m_radius;
     result.m_maxX = position.x + m_radius;
@@ -82,22 +313,47 @@ AABB SphereCollider::getAABB() const {
 }
 
 glm::vec3 SphereCollider::getSupportPoint(const glm::vec3& direction) const {
-    return r_transform->getPosition() + direction * m_radius;
+    return getPosition() + direction * m_radius;
 }
 
 glm::vec3 SphereCollider::getClosestPoint(const glm::vec3& position) const {
-    return getSupportPoint(glm::normalize(position - r_transform->getPosition()));
+    return getSupportPoint(glm::normalize(position - getPosition()));
 }
 
-void SphereCollider::addNormalsToVector(std::vector<glm::vec3>& normals, const Collider& other) const {
-    glm::vec3 position = r_transform->getPosition();
+void SphereCollider::addNormalsToVector(std::pmr::vector<glm::vec3>& normals, const Collider& other) const {
+    glm::vec3 position = getPosition();
     glm::vec3 otherClosestPoint = other.getClosestPoint(position);
     normals.push_back(glm::normalize(otherClosestPoint - position));
 }
 
-AABB CapsuleCollider::getAABB() const {
+std::array<glm::vec3, 2> CapsuleCollider::getSegment() const {
+    if (r_cache) return r_cache->m_segments[m_cacheIndex];
+
+    glm::vec3 centre = r_transform->getWorldPosition();
+    glm::vec3 up = r_transform->getUp() * m_halfHeight;
+    return { centre + up, centre - up };
+}
+
+uint32_t CapsuleCollider::reserveCache(ColliderCache& cache) const {
+    cache.m_segments.emplace_back();
+    return static_cast<uint32_t>(cache.m_segments.size() - 1);
+}
+
+void CapsuleCollider::fillCache(ColliderCache& cache) const {
+    auto segment = getSegment();
+
+    cache.m_segments[m_cacheIndex] = segment;
+    cache.m_positions[m_cacheSlot] = r_transform->getWorldPosition();
+    cache.m_boxes[m_cacheSlot] = AABB {
+        std::min(segment[0].x, segment[1].x), std::max(segment[0].x, segment[1].x),
+        std::min(segment[0].y, segment[1].y), std::max(segment[0].y, segment[1].y),
+        std::min(segment[0].z, segment[1].z), std::max(segment[0].z, segment[1].z),
+    }.expand(m_radius);
+}
+
+AABB CapsuleCollider::computeAABB() const {
     AABB result;
-    glm::vec3 position = r_transform->getPosition();
+    glm::vec3 position = getPosition();
 
     result.m_minX = result.m_maxX = position.x;
     result.m_minY = result.m_maxY = position.y;
@@ -114,9 +370,7 @@ AABB CapsuleCollider::getAABB() const {
 }
 
 glm::vec3 CapsuleCollider::getSupportPoint(const glm::vec3& direction) const {
-    glm::vec3 centre = r_transform->getPosition();
-    glm::vec3 topPoint = centre + r_transform->getUp() * m_halfHeight;
-    glm::vec3 bottomPoint = centre - r_transform->getUp() * m_halfHeight;
+    auto [ topPoint, bottomPoint ] = getSegment();
 
     float topValue = glm::dot(direction, topPoint);
     float bottomValue = glm::dot(direction, bottomPoint);
@@ -127,9 +381,7 @@ glm::vec3 CapsuleCollider::getSupportPoint(const glm::vec3& direction) const {
 }
 
 glm::vec3 CapsuleCollider::getClosestPoint(const glm::vec3& position) const {
-    glm::vec3 centre = r_transform->getPosition();
-    glm::vec3 topPoint = centre + r_transform->getUp() * m_halfHeight;
-    glm::vec3 bottomPoint = centre - r_transform->getUp() * m_halfHeight;
+    auto [ topPoint, bottomPoint ] = getSegment();
 
     float topDistance = glm::distance2(topPoint, position);
     float bottomDistance = glm::distance2(bottomPoint, position);
@@ -140,10 +392,8 @@ glm::vec3 CapsuleCollider::getClosestPoint(const glm::vec3& position) const {
     return point + glm::normalize(direction) * m_radius;
 }
 
-void CapsuleCollider::addNormalsToVector(std::vector<glm::vec3>& normals, const Collider& other) const {
-    glm::vec3 centre = r_transform->getPosition();
-    glm::vec3 topPoint = centre + r_transform->getUp() * m_halfHeight;
-    glm::vec3 bottomPoint = centre - r_transform->getUp() * m_halfHeight;
+void CapsuleCollider::addNormalsToVector(std::pmr::vector<glm::vec3>& normals, const Collider& other) const {
+    auto [ topPoint, bottomPoint ] = getSegment();
 
     glm::vec3 topClosestPoint = other.getClosestPoint(topPoint);
     glm::vec3 bottomClosestPoint = other.getClosestPoint(bottomPoint);
@@ -176,6 +426,8 @@ std::array<glm::vec3, 8> OBBCollider::getModelSpaceCorners() const {
 }
 
 std::array<glm::vec3, 8> OBBCollider::getWorldSpaceCorners() const {
+    if (r_cache) return r_cache->m_corners[m_cacheIndex];
+
     std::array<glm::vec3, 8> modelSpaceCorners = getModelSpaceCorners();
     std::array<glm::vec3, 8> worldSpaceCorners;
 
@@ -190,7 +442,30 @@ std::array<glm::vec3, 8> OBBCollider::getWorldSpaceCorners() const {
     return worldSpaceCorners;
 }
 
-AABB OBBCollider::getAABB() const {
+uint32_t OBBCollider::reserveCache(ColliderCache& cache) const {
+    cache.m_corners.emplace_back();
+    cache.m_axes.emplace_back();
+    return static_cast<uint32_t>(cache.m_corners.size() - 1);
+}
+
+void OBBCollider::fillCache(ColliderCache& cache) const {
+    cache.m_corners[m_cacheIndex] = getWorldSpaceCorners();
+    cache.m_axes[m_cacheIndex] = { r_transform->getForward(), r_transform->getUp(), r_transform->getRight() };
+    cache.m_positions[m_cacheSlot] = r_transform->getWorldPosition();
+
+    // the box comes from the corners that were just cached, rather than transforming them all again
+    AABB box;
+    const auto& corners = cache.m_corners[m_cacheIndex];
+    box.m_minX = box.m_maxX = corners[0].x;
+    box.m_minY = box.m_maxY = corners[0].y;
+    box.m_minZ = box.m_maxZ = corners[0].z;
+    for (const auto& corner : corners)
+        box = box.merge({ corner.x, corner.x, corner.y, corner.y, corner.z, corner.z });
+
+    cache.m_boxes[m_cacheSlot] = box;
+}
+
+AABB OBBCollider::computeAABB() const {
     AABB result;
     bool firstCorner = true;
 
@@ -252,7 +527,13 @@ glm::vec3 OBBCollider::getClosestPoint(const glm::vec3& position) const {
     return result;
 }
 
-void OBBCollider::addNormalsToVector(std::vector<glm::vec3>& normals, const Collider& other) const {
+void OBBCollider::addNormalsToVector(std::pmr::vector<glm::vec3>& normals, const Collider& other) const {
+    if (r_cache) {
+        const auto& axes = r_cache->m_axes[m_cacheIndex];
+        normals.insert(normals.end(), axes.begin(), axes.end());
+        return;
+    }
+
     normals.push_back(r_transform->getForward());
     normals.push_back(r_transform->getUp());
     normals.push_back(r_transform->getRight());
@@ -262,11 +543,11 @@ void CollisionSystem::BSPT::findSplitPlane(CollisionSystem::BSPT::Axis& axis, fl
     glm::vec3 variance, meanPosition;
 
     for (const auto& child : m_children)
-        meanPosition += child->m_collider->r_transform->getPosition();
+        meanPosition += child->m_collider->getPosition();
     meanPosition /= static_cast<float>(m_children.size());
 
     for (const auto& child : m_children) {
-        glm::vec3 diff = child->m_collider->r_transform->getPosition() - meanPosition;
+        glm::vec3 diff = child->m_collider->getPosition() - meanPosition;
         variance += diff * diff;
     }
 
@@ -283,11 +564,18 @@ void CollisionSystem::BSPT::findSplitPlane(CollisionSystem::BSPT::Axis& axis, fl
     }
 }
 
+CollisionSystem::BSPT::~BSPT() {
+    std::pmr::polymorphic_allocator<BSPT> allocator { r_memory };
+    if (m_left) allocator.delete_object(m_left);
+    if (m_right) allocator.delete_object(m_right);
+}
+
 void CollisionSystem::BSPT::split(int depth) {
     if (depth >= MAX_DEPTH || m_children.size() <= MIN_CHILDREN) return;
 
-    m_left = std::make_unique<BSPT>();
-    m_right = std::make_unique<BSPT>();
+    std::pmr::polymorphic_allocator<BSPT> allocator { r_memory };
+    m_left = allocator.new_object<BSPT>(r_memory);
+    m_right = allocator.new_object<BSPT>(r_memory);
 
     Axis axis;
     float distance;
@@ -324,39 +612,195 @@ void CollisionSystem::BSPT::split(int depth) {
     m_right->split(depth + 1);
 }
 
-void CollisionSystem::BSPT::generateCollisionEvents(std::vector<CollisionEvent>& collisionEvents) {
+void CollisionSystem::BSPT::findPairs(const CollisionComponent* first, std::pmr::vector<CollisionPair>& pairs) {
+    if (!isLeaf()) {
+        if (m_left) m_left->findPairs(first, pairs);
+        if (m_right) m_right->findPairs(first, pairs);
+        return;
+    }
+
+    std::pmr::vector<AABB> boxes { r_memory };
+    boxes.reserve(m_children.size());
+    for (const auto child : m_children) boxes.push_back(child->getAABB());
+
+    for (size_t i = 0; i < m_children.size(); i++)
+    for (size_t j = i + 1; j < m_children.size(); j++)
+    if (boxes[i].checkIntersection(boxes[j])) {
+        uint32_t a = static_cast<uint32_t>(m_children[i] - first);
+        uint32_t b = static_cast<uint32_t>(m_children[j] - first);
+        pairs.push_back({ std::min(a, b), std::max(a, b) });
+    }
+}
+
+void CollisionSystem::BSPT::getLeaves(std::pmr::vector<BSPT*>& leaves) {
     if (isLeaf()) {
-        CollisionEvent event;
-        for (auto& collider1 : m_children)
-        for (auto& collider2 : m_children)
-        if (collider1->m_entity != collider2->m_entity)
-        if (collider1->checkCollision(*collider2, event)) {
-            event.m_thisEntity = collider1->m_entity;
-            event.m_otherEntity = collider2->m_entity;
-            collisionEvents.push_back(event);
-        }
+        leaves.push_back(this);
     } else {
-        if (m_left) m_left->generateCollisionEvents(collisionEvents);
-        if (m_right) m_right->generateCollisionEvents(collisionEvents);
+        if (m_left) m_left->getLeaves(leaves);
+        if (m_right) m_right->getLeaves(leaves);
+    }
+}
+
+namespace {
+
+// calls func with a copy of collider that's wherever transform is, without allocating
+template<typename Func>
+void withTransform(const Collider& collider, const TransformComponent* transform, Func&& func) {
+    auto moved = [&](auto copy) {
+        // the copy works its shape out from the moved transform, not the cache
+        copy.r_transform = transform;
+        copy.r_cache = nullptr;
+        func(static_cast<const Collider&>(copy));
+    };
+
+    switch (collider.m_type) {
+    case Collider::e_sphere: moved(static_cast<const SphereCollider&>(collider)); break;
+    case Collider::e_capsule: moved(static_cast<const CapsuleCollider&>(collider)); break;
+    case Collider::e_obb: moved(static_cast<const OBBCollider&>(collider)); break;
+    default: break;
+    }
+}
+
+}
+
+void CollisionSystem::testPair(const CollisionComponent& a, const CollisionComponent& b, const glm::vec3& offset, std::pmr::vector<CollisionEvent>& events) {
+    CollisionEvent event;
+
+    if (offset == glm::vec3 { 0.f }) {
+        if (a.m_collider->checkShapes(*b.m_collider, event)) {
+            event.m_thisEntity = a.m_entity;
+            event.m_otherEntity = b.m_entity;
+            events.push_back(event);
+            events.push_back(event.mirror());
+        }
+
+        return;
     }
+
+    // b only touches a across a periodic boundary, so a copy of it is moved next to a, which only works for
+    // transforms without a parent
+    TransformComponent transform = *b.m_collider->r_transform;
+    transform.setPosition(transform.getPosition() + offset);
+
+    withTransform(*b.m_collider, &transform, [&](const Collider& moved) {
+        if (a.m_collider->checkShapes(moved, event)) {
+            event.m_thisEntity = a.m_entity;
+            event.m_otherEntity = b.m_entity;
+            events.push_back(event);
+
+            // b's event is back where b really is
+            events.push_back(event.mirror());
+            events.back().m_collisionPoint -= offset;
+        }
+    });
 }
 
-std::vector<CollisionEvent> CollisionSystem::getCollisionEvents() {
-    auto transformSystem = r_ecsManager->getSystem<TransformComponent>("Transform");
+void CollisionSystem::updateCache() {
+    auto transformSystem = r_ecsManager->getSystem<TransformComponent>();
 
-    BSPT bspt;
-    for (auto& [ entity, comp ] : m_components) {
-        comp.m_collider->r_transform = transformSystem->getComponent(entity);
-        bspt.m_children.push_back(&comp);
+    // rebuild every stale matrix in one batch, rather than one at a time below
+    if (auto batched = dynamic_cast<TransformSystem*>(transformSystem)) batched->updateMatrices(r_jobSystem);
+
+    // every collider's world space shape is worked out once up front, and everything after reads it from the cache
+    m_cache.m_corners.clear();
+    m_cache.m_axes.clear();
+    m_cache.m_segments.clear();
+    m_cache.m_boxes.resize(m_components.size());
+    m_cache.m_positions.resize(m_components.size());
+
+    for (uint32_t slot = 0; slot < m_components.size(); slot++) {
+        auto& comp = m_components[slot];
+        Collider& collider = *comp.m_collider;
+        collider.r_transform = transformSystem->readComponent(comp.m_entity);
+
+        // transforms cache their matrix the first time it's read, so make sure that has happened
+        // before any of them are shared between threads
+        collider.r_transform->getMat4();
+
+        collider.r_cache = nullptr;
+        collider.m_cacheSlot = slot;
+        collider.m_cacheIndex = collider.reserveCache(m_cache);
     }
 
-    bspt.split();
+    auto fillCache = [&](size_t begin, size_t end) {
+        for (size_t slot = begin; slot < end; slot++) m_components[slot].m_collider->fillCache(m_cache);
+    };
 
-    std::vector<CollisionEvent> events;
+    constexpr size_t COLLIDERS_PER_GRAIN = 1024;
+    if (r_jobSystem) r_jobSystem->parallelFor(0, m_components.size(), COLLIDERS_PER_GRAIN, fillCache);
+    else fillCache(0, m_components.size());
 
-    bspt.generateCollisionEvents(events);
+    for (auto& comp : m_components) comp.m_collider->r_cache = &m_cache;
+}
+
+std::pmr::vector<CollisionEvent> CollisionSystem::getCollisionEvents(std::pmr::memory_resource* memory) {
+    updateCache();
+
+    std::pmr::vector<CollisionPair> pairs { memory };
+
+    if (r_broadphase) {
+        r_broadphase->findPairs(*this, pairs);
+    } else {
+        BSPT bspt { memory };
+        bspt.m_children.reserve(m_components.size());
+        for (auto& comp : m_components) bspt.m_children.push_back(&comp);
+
+        bspt.split();
+
+        const CollisionComponent* first = m_components.data();
+
+        if (!r_jobSystem) {
+            bspt.findPairs(first, pairs);
+        } else {
+            std::pmr::vector<BSPT*> leaves { memory };
+            bspt.getLeaves(leaves);
+
+            std::pmr::vector<std::pmr::vector<CollisionPair>> leafPairs { leaves.size(), memory };
+            r_jobSystem->parallelFor(0, leaves.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                    leaves[i]->findPairs(first, leafPairs[i]);
+            });
+
+            size_t pairCount = 0;
+            for (const auto& leaf : leafPairs) pairCount += leaf.size();
+            pairs.reserve(pairCount);
+
+            for (const auto& leaf : leafPairs)
+                pairs.insert(pairs.end(), leaf.begin(), leaf.end());
+        }
+
+        // pairs that straddle a split were found in every leaf they're in
+        std::sort(pairs.begin(), pairs.end());
+        pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    }
+
+    std::pmr::vector<CollisionEvent> events { memory };
+
+    if (!r_jobSystem) {
+        for (const auto& pair : pairs) testPair(m_components[pair.m_a], m_components[pair.m_b], pair.m_offset, events);
+    } else {
+        constexpr size_t PAIRS_PER_GRAIN = 256;
+        size_t grains = (pairs.size() + PAIRS_PER_GRAIN - 1) / PAIRS_PER_GRAIN;
+
+        std::pmr::vector<std::pmr::vector<CollisionEvent>> grainEvents { grains, memory };
+        r_jobSystem->parallelFor(0, grains, 1, [&](size_t begin, size_t end) {
+            for (size_t grain = begin; grain < end; grain++)
+            for (size_t i = grain * PAIRS_PER_GRAIN; i < std::min(pairs.size(), (grain + 1) * PAIRS_PER_GRAIN); i++)
+                testPair(m_components[pairs[i].m_a], m_components[pairs[i].m_b], pairs[i].m_offset, grainEvents[grain]);
+        });
+
+        size_t eventCount = 0;
+        for (const auto& grain : grainEvents) eventCount += grain.size();
+        events.reserve(eventCount);
+
+        for (const auto& grain : grainEvents)
+            events.insert(events.end(), grain.begin(), grain.end());
+    }
+
+    // components can be added, removed and moved before the next step, so nothing reads the cache outside of one
+    for (auto& comp : m_components) comp.m_collider->r_cache = nullptr;
 
     return events;
 }
 
-}
\ No newline at end of file
+}
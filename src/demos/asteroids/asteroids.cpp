@@ -8,6 +8,9 @@
 #include <postProcessing.hpp>
 #include <taa.hpp>
 #include <bloom.hpp>
+#include <scheduler.hpp>
+#include <spatialSorter.hpp>
+#include <broadphase.hpp>
 
 #include "logic.hpp"
 
@@ -59,11 +62,34 @@ class Asteroids : public mge::Engine {
     BulletSystem m_bulletSystem;
     SpaceshipSystem m_spaceshipSystem;
     mge::ecs::RigidbodySystem m_rigidbodySystem;
-    mge::ecs::System<mge::ecs::TransformComponent> m_transformSystem;
+    mge::ecs::TransformSystem m_transformSystem;
     mge::ecs::CollisionSystem m_collisionSystem;
+    // asteroids wrap around the spaceship, so they can collide across the edge of the field
+    mge::ecs::UniformGrid m_broadphase { 20.f, 2.f * AsteroidSystem::MAX_DISTANCE };
     mge::ecs::ModelSystem m_modelSystem;
     mge::ecs::LightSystem m_lightSystem;
 
+    mge::ecs::Scheduler m_scheduler;
+
+    // keeps the physics components in Morton order so neighbouring asteroids are neighbours in memory
+    mge::ecs::SpatialSorter m_spatialSorter { [this](const mge::ecs::Entity& entity, float (&position)[3]) {
+        auto transform = m_transformSystem.readComponent(entity);
+        if (!transform) return false;
+
+        glm::vec3 worldPosition = transform->getPosition();
+        for (int axis = 0; axis < 3; axis++) position[axis] = worldPosition[axis];
+        return true;
+    } };
+
+    // the components every asteroid starts with, randomised afterwards by randomiseAsteroid
+    mge::ecs::Prefab m_asteroidPrefab;
+
+    // per-frame state read by the scheduled tasks
+    // shares the frame arena with getCollisionEvents' result, so assigning that each frame just takes its memory
+    std::pmr::vector<mge::ecs::CollisionEvent> m_collisionEvents { &m_frameArena };
+    float m_deltaTime = 0.f;
+    bool m_accelerate, m_pitchUp, m_pitchDown, m_turnLeft, m_turnRight, m_fire;
+
     mge::HDRColourCorrection m_hdrColourCorrection;
     mge::TAA m_taa;
     mge::Bloom m_bloom;
@@ -187,6 +213,11 @@ class Asteroids : public mge::Engine {
         m_ecsManager.addSystem("Light", &m_lightSystem);
         m_ecsManager.addSystem("Collision", &m_collisionSystem);
 
+        m_collisionSystem.r_jobSystem = &m_jobSystem;
+        m_collisionSystem.r_broadphase = &m_broadphase;
+
+        m_spatialSorter.addSystem(&m_transformSystem).addSystem(&m_collisionSystem).addSystem(&m_rigidbodySystem);
+
         m_camera->setup();
 
         m_lightMaterial->setup();
@@ -216,6 +247,7 @@ class Asteroids : public mge::Engine {
         m_bloom.setup();
         
         makeTemplates();
+        makeSchedule();
 
         for (int i = 0; i < 3; i++) {
             auto sunEntity = m_ecsManager.makeEntity();
@@ -239,8 +271,9 @@ class Asteroids : public mge::Engine {
         ambientLightInstance->m_type = ambientLightInstance->e_ambient;
         ambientLightInstance->m_colour = glm::vec3 { 0.02f };
 
-        for (int i = 0; i < 4'000; i++)
-            auto entity = m_ecsManager.makeEntityFromTemplate("Asteroid");
+        m_ecsManager.spawnBatch(m_asteroidPrefab, 4'000, [&](mge::ecs::ECSManager&, const mge::ecs::Entity& entity, size_t) {
+            randomiseAsteroid(entity);
+        });
 
         auto spaceshipEntity = m_ecsManager.makeEntityFromTemplate("Spaceship");
         auto spaceshipTransform = m_transformSystem.getComponent(spaceshipEntity);
@@ -249,32 +282,45 @@ class Asteroids : public mge::Engine {
         m_camera->m_up = spaceshipTransform->getUp();
     }
 
+    void randomiseAsteroid(const mge::ecs::Entity& entity) {
+        auto transform = m_transformSystem.getComponent(entity);
+        auto rigidbody = m_rigidbodySystem.getComponent(entity);
+        auto collider = m_collisionSystem.getComponent(entity);
+
+        float radius = glm::mix(5.f, 40.f, glm::pow(randomRangeFloat(0.f, 1.f), 10.f));
+        collider->setCollider(mge::ecs::SphereCollider(radius));
+
+        transform->setPosition(glm::vec3 {
+            randomRangeFloat(-1.f, 1.f),
+            randomRangeFloat(-1.f, 1.f),
+            randomRangeFloat(-1.f, 1.f)
+        } * AsteroidSystem::MAX_DISTANCE);
+        transform->setRotation(glm::angleAxis(randomRangeFloat(-glm::pi<float>(), glm::pi<float>()), randomUnitVector()));
+        transform->setScale(glm::vec3 { radius });
+
+        rigidbody->m_velocity = randomUnitVector() * randomRangeFloat(0.f, 15.f) * glm::vec3 { 1.f, 1.f, 1.f };
+        rigidbody->m_mass = radius * radius * radius;
+        rigidbody->m_angularVelocity = randomRangeFloat(0.f, 1.f) * randomUnitVector();
+    }
+
     void makeTemplates() {
-        m_ecsManager.addTemplate("Asteroid", [&](mge::ecs::ECSManager& ecs) {
-            auto entity = ecs.makeEntity();
+        mge::ecs::RigidbodyComponent asteroidRigidbody {};
+        asteroidRigidbody.m_physicsType = asteroidRigidbody.e_dynamic;
 
-            auto transform = m_transformSystem.addComponent(entity);
-            auto rigidbody = m_rigidbodySystem.addComponent(entity);
-            auto model = m_modelSystem.addComponent(entity, "Asteroid");
-            auto collider = m_collisionSystem.addComponent(entity);
-            auto asteroid = m_asteroidSystem.addComponent(entity);
-
-            float radius = glm::mix(5.f, 40.f, glm::pow(randomRangeFloat(0.f, 1.f), 10.f));
-            collider->setCollider(mge::ecs::SphereCollider(radius));
-
-            transform->setPosition(glm::vec3 {
-                randomRangeFloat(-1.f, 1.f),
-                randomRangeFloat(-1.f, 1.f),
-                randomRangeFloat(-1.f, 1.f)
-            } * AsteroidSystem::MAX_DISTANCE);
-            transform->setRotation(glm::angleAxis(randomRangeFloat(-glm::pi<float>(), glm::pi<float>()), randomUnitVector()));
-            transform->setScale(glm::vec3 { radius });
-
-            rigidbody->m_velocity = randomUnitVector() * randomRangeFloat(0.f, 15.f) * glm::vec3 { 1.f, 1.f, 1.f };
-            rigidbody->m_physicsType = rigidbody->e_dynamic;
-            rigidbody->m_mass = radius * radius * radius;
-            rigidbody->m_angularVelocity = randomRangeFloat(0.f, 1.f) * randomUnitVector();
+        mge::ecs::ModelComponent asteroidModel {};
+        asteroidModel.m_modelName = "Asteroid";
+
+        m_asteroidPrefab
+            .add<mge::ecs::TransformComponent>(mge::ecs::TransformComponent {})
+            .add(asteroidRigidbody)
+            .add(asteroidModel)
+            .add<mge::ecs::CollisionComponent>()
+            .add<AsteroidComponent>(AsteroidComponent {});
 
+        // single asteroids, like the fragments of one that's been shot, come from the same prefab
+        m_ecsManager.addTemplate("Asteroid", [&](mge::ecs::ECSManager& ecs) {
+            auto entity = ecs.spawnBatch(m_asteroidPrefab, 1).front();
+            randomiseAsteroid(entity);
             return entity;
         });
 
@@ -327,8 +373,47 @@ class Asteroids : public mge::Engine {
         });
     }
 
+    void makeSchedule() {
+        // the collision pass calls the transforms' lazily cached matrix getters, so it counts as writing to them
+        m_scheduler.addTask("Collision", [&]{ m_collisionEvents = m_collisionSystem.getCollisionEvents(&m_frameArena); })
+            .writes<mge::ecs::CollisionComponent, mge::ecs::TransformComponent>();
+
+        m_scheduler.addTask("Bullet hits", [&]{ m_bulletSystem.handleCollisions(m_collisionEvents); })
+            .reads<BulletComponent, AsteroidComponent, mge::ecs::CollisionComponent, mge::ecs::TransformComponent, mge::ecs::RigidbodyComponent>();
+
+        m_scheduler.addTask("Spaceship hits", [&]{ m_spaceshipSystem.checkForAsteroidCollision(m_collisionEvents); })
+            .reads<AsteroidComponent, mge::ecs::CollisionComponent>()
+            .writes<SpaceshipComponent, mge::ecs::RigidbodyComponent>();
+
+        m_scheduler.addTask("Resolve collisions", [&]{ m_rigidbodySystem.resolveCollisions(m_collisionEvents); })
+            .reads<mge::ecs::CollisionComponent>()
+            .writes<mge::ecs::RigidbodyComponent, mge::ecs::TransformComponent>();
+
+        m_scheduler.addTask("Integrate", [&]{ m_rigidbodySystem.update(m_deltaTime); })
+            .writes<mge::ecs::RigidbodyComponent, mge::ecs::TransformComponent>();
+
+        m_scheduler.addTask("Bullet ageing", [&]{ m_bulletSystem.destroyOldBullets(m_deltaTime); })
+            .writes<BulletComponent>();
+
+        m_scheduler.addTask("Spaceship control", [&]{
+            m_spaceshipSystem.update(m_deltaTime, m_accelerate, m_pitchUp, m_pitchDown, m_turnLeft, m_turnRight, m_fire);
+        }).writes<SpaceshipComponent, mge::ecs::TransformComponent, mge::ecs::RigidbodyComponent>();
+
+        m_scheduler.addTask("Wrap asteroids", [&]{
+            if (m_spaceshipSystem.m_components.begin()->isAlive())
+                m_asteroidSystem.wrapAsteroids();
+        }).reads<SpaceshipComponent, AsteroidComponent>().writes<mge::ecs::TransformComponent>();
+    }
+
+    void keyCallback(int key, int scancode, int action, int mods) override {
+        if (key == GLFW_KEY_T && action == GLFW_PRESS)
+            m_scheduler.printTimings(std::cout);
+    }
+
     void updateBuffers() override {
         m_camera->updateBuffer();
+        m_transformSystem.updateMatrices(&m_jobSystem);
+        m_transformSystem.swapBuffers();
         // m_skyboxModel->updateInstanceBuffer();
         m_modelSystem.updateTransforms();
         m_lightSystem.update();
@@ -397,32 +482,29 @@ class Asteroids : public mge::Engine {
     }
 
     void update(double deltaTime) override {
-        auto collisionEvents = m_collisionSystem.getCollisionEvents();
+        m_ecsManager.advanceTick();
+        m_deltaTime = deltaTime;
 
-        m_bulletSystem.handleCollisions(collisionEvents);
-        m_spaceshipSystem.checkForAsteroidCollision(collisionEvents);
-        m_rigidbodySystem.resolveCollisions(collisionEvents);
+        m_accelerate = glfwGetKey(m_window, GLFW_KEY_W) == GLFW_PRESS;
+        m_pitchUp = glfwGetKey(m_window, GLFW_KEY_UP) == GLFW_PRESS;
+        m_pitchDown = glfwGetKey(m_window, GLFW_KEY_DOWN) == GLFW_PRESS;
+        m_turnLeft = glfwGetKey(m_window, GLFW_KEY_LEFT) == GLFW_PRESS;
+        m_turnRight = glfwGetKey(m_window, GLFW_KEY_RIGHT) == GLFW_PRESS;
+        m_fire = glfwGetKey(m_window, GLFW_KEY_E) == GLFW_PRESS;
 
-        m_rigidbodySystem.update(deltaTime);
+        m_scheduler.run(m_jobSystem);
 
-        m_bulletSystem.destroyOldBullets(deltaTime);
+        // apply the spawns and destroys recorded by the scheduled systems
+        m_ecsManager.flush();
 
-        bool accelerate = glfwGetKey(m_window, GLFW_KEY_W) == GLFW_PRESS;
-        bool pitchUp = glfwGetKey(m_window, GLFW_KEY_UP) == GLFW_PRESS;
-        bool pitchDown = glfwGetKey(m_window, GLFW_KEY_DOWN) == GLFW_PRESS;
-        bool turnLeft = glfwGetKey(m_window, GLFW_KEY_LEFT) == GLFW_PRESS;
-        bool turnRight = glfwGetKey(m_window, GLFW_KEY_RIGHT) == GLFW_PRESS;
-        bool fire = glfwGetKey(m_window, GLFW_KEY_E) == GLFW_PRESS;
+        // asteroids drift slowly, so a pass spread over a few frames keeps up, and this is a sync point where
+        // moving components around can't pull them out from under a running task
+        m_spatialSorter.step(1'024);
 
-        m_spaceshipSystem.update(deltaTime, accelerate, pitchUp, pitchDown, turnLeft, turnRight, fire);
-
-        auto spaceshipEntity = m_spaceshipSystem.m_components.begin()->first;
-
-        auto spaceship = m_spaceshipSystem.getComponent(spaceshipEntity);
-        auto spaceshipTransform = m_transformSystem.getComponent(spaceshipEntity);
+        auto spaceshipEntity = m_spaceshipSystem.m_components.begin()->m_entity;
 
-        if (spaceship->isAlive())
-            m_asteroidSystem.wrapAsteroids();
+        auto spaceship = m_spaceshipSystem.readComponent(spaceshipEntity);
+        auto spaceshipTransform = m_transformSystem.readComponent(spaceshipEntity);
 
         glm::vec3 cameraTargetPosition, cameraFocus, cameraUp;
         float targetFov;
@@ -9,6 +9,9 @@
 #include <ecsManager.hpp>
 #include <modelInstance.hpp>
 
+#include <algorithm>
+#include <vector>
+
 struct AsteroidComponent : public mge::ecs::Component {};
 
 struct BulletComponent : public mge::ecs::Component {
@@ -36,17 +39,15 @@ public:
     static constexpr float MAX_DISTANCE = 500.f;
 
     void wrapAsteroids() {
-        auto spaceshipSystem = r_ecsManager->getSystem<SpaceshipComponent>("Spaceship");
-        auto transformSystem = r_ecsManager->getSystem<mge::ecs::TransformComponent>("Transform");
+        auto spaceshipSystem = r_ecsManager->getSystem<SpaceshipComponent>();
+        auto transformSystem = r_ecsManager->getSystem<mge::ecs::TransformComponent>();
 
-        auto spaceshipEntity = spaceshipSystem->m_components.begin()->first;
-        auto spaceshipTransform = transformSystem->getComponent(spaceshipEntity);
+        auto spaceshipEntity = spaceshipSystem->m_components.begin()->m_entity;
+        auto spaceshipTransform = transformSystem->readComponent(spaceshipEntity);
         glm::vec3 spaceshipPosition = spaceshipTransform->getPosition();
 
-        for (auto& [ entity, component ] : m_components) {
-            auto asteroidTransform = transformSystem->getComponent(entity);
-
-            glm::vec3 asteroidPosition = asteroidTransform->getPosition();
+        for (auto& component : m_components) {
+            glm::vec3 asteroidPosition = transformSystem->readComponent(component.m_entity)->getPosition();
             glm::vec3 relpos = asteroidPosition - spaceshipPosition; // asteroid relative position
             
             if (relpos.x >  MAX_DISTANCE) relpos.x -= 2.f * MAX_DISTANCE;
@@ -56,81 +57,93 @@ public:
             if (relpos.z >  MAX_DISTANCE) relpos.z -= 2.f * MAX_DISTANCE;
             if (relpos.z < -MAX_DISTANCE) relpos.z += 2.f * MAX_DISTANCE;
 
-            asteroidTransform->setPosition(spaceshipPosition + relpos);
+            // only asteroids that actually wrap are marked as changed
+            if (spaceshipPosition + relpos != asteroidPosition)
+                transformSystem->getComponent(component.m_entity)->setPosition(spaceshipPosition + relpos);
         }
     }
 
     void breakApart(const mge::ecs::Entity& entity) {
-        auto transformSystem = r_ecsManager->getSystem<mge::ecs::TransformComponent>("Transform");
-        auto collisionSystem = r_ecsManager->getSystem<mge::ecs::CollisionComponent>("Collision");
-        auto rigidbodySystem = r_ecsManager->getSystem<mge::ecs::RigidbodyComponent>("Rigidbody");
+        auto transformSystem = r_ecsManager->getSystem<mge::ecs::TransformComponent>();
+        auto collisionSystem = r_ecsManager->getSystem<mge::ecs::CollisionComponent>();
+        auto rigidbodySystem = r_ecsManager->getSystem<mge::ecs::RigidbodyComponent>();
 
-        auto asteroid = getComponent(entity);
-        auto oldTransform = transformSystem->getComponent(entity);
-        auto oldRigidbody = rigidbodySystem->getComponent(entity);
-        auto oldCollision = collisionSystem->getComponent(entity);
+        auto oldCollision = collisionSystem->readComponent(entity);
 
         float radius = static_cast<mge::ecs::SphereCollider*>(oldCollision->m_collider.get())->m_radius;
 
         if (radius <= 3.f) return;
 
+        glm::vec3 oldPosition = transformSystem->readComponent(entity)->getPosition();
+        auto oldRigidbody = rigidbodySystem->readComponent(entity);
+
         auto breakAxis = mge::Engine::randomUnitVector() * mge::Engine::randomRangeFloat(10.f, 50.f);
 
         for (float i = -1.f; i <= 1.f; i += 2.f) {
             float newRadius = radius * 0.5f;
+            float newMass = newRadius * newRadius * newRadius;
 
-            auto newEntity = r_ecsManager->makeEntityFromTemplate("Asteroid");
+            glm::vec3 position = oldPosition + glm::normalize(breakAxis) * i * newRadius;
 
-            auto transform = transformSystem->getComponent(newEntity);
-            auto collision = collisionSystem->getComponent(newEntity);
-            auto rigidbody = rigidbodySystem->getComponent(newEntity);
+            glm::vec3 velocity = oldRigidbody->m_velocity;
+            velocity += breakAxis * i * oldRigidbody->m_mass / (8.f * newMass);
 
-            transform->setPosition(oldTransform->getPosition() + glm::normalize(breakAxis) * i * newRadius);
-            transform->setScale(glm::vec3 { newRadius });
+            glm::vec3 angularVelocity = oldRigidbody->m_angularVelocity;
+            angularVelocity += mge::Engine::randomUnitVector() * mge::Engine::randomRangeFloat(3.f, 10.f);
 
-            collision->setCollider(mge::ecs::SphereCollider(newRadius));
+            // fragments are spawned at the next flush, so everything they need is captured by value
+            r_ecsManager->m_commandBuffer.spawn("Asteroid", [=](mge::ecs::ECSManager& ecs, const mge::ecs::Entity& newEntity) {
+                auto transform = ecs.getSystem<mge::ecs::TransformComponent>()->getComponent(newEntity);
+                auto collision = ecs.getSystem<mge::ecs::CollisionComponent>()->getComponent(newEntity);
+                auto rigidbody = ecs.getSystem<mge::ecs::RigidbodyComponent>()->getComponent(newEntity);
 
-            rigidbody->m_mass = newRadius * newRadius * newRadius;
-            
-            rigidbody->m_velocity = oldRigidbody->m_velocity;
-            rigidbody->m_velocity += breakAxis * i * oldRigidbody->m_mass / (8.f * rigidbody->m_mass);
+                transform->setPosition(position);
+                transform->setScale(glm::vec3 { newRadius });
+
+                collision->setCollider(mge::ecs::SphereCollider(newRadius));
 
-            rigidbody->m_angularVelocity = oldRigidbody->m_angularVelocity;
-            rigidbody->m_angularVelocity += mge::Engine::randomUnitVector() * mge::Engine::randomRangeFloat(3.f, 10.f);
+                rigidbody->m_mass = newMass;
+                rigidbody->m_velocity = velocity;
+                rigidbody->m_angularVelocity = angularVelocity;
+            });
         }
     }
 };
 
 class BulletSystem : public mge::ecs::System<BulletComponent> {
+    // what handleCollisions has destroyed so far, only a few a frame so it's searched linearly and kept for reuse
+    std::vector<mge::ecs::Entity> m_destroyed;
+
+    bool alreadyDestroyed(const mge::ecs::Entity& entity) const {
+        return std::find(m_destroyed.begin(), m_destroyed.end(), entity) != m_destroyed.end();
+    }
+
 public:
     static constexpr float MAX_AGE = 3.f;
 
     void destroyOldBullets(float deltaTime) {
-        std::vector<mge::ecs::Entity> entitiesToDestroy;
-
-        for (auto& [ entity, comp ] : m_components)
+        for (auto& comp : m_components)
             if ((comp.m_age += deltaTime) > MAX_AGE)
-                entitiesToDestroy.push_back(entity);
-        
-        for (const auto& entity : entitiesToDestroy)
-            r_ecsManager->destroyEntity(entity);
+                r_ecsManager->m_commandBuffer.destroy(comp.m_entity);
     }
 
-    void handleCollisions(const std::vector<mge::ecs::CollisionEvent>& collisionEvents) {
-        auto asteroidSystem = static_cast<AsteroidSystem*>(r_ecsManager->getSystem<AsteroidComponent>("Asteroid"));
+    void handleCollisions(std::span<const mge::ecs::CollisionEvent> collisionEvents) {
+        auto asteroidSystem = static_cast<AsteroidSystem*>(r_ecsManager->getSystem<AsteroidComponent>());
 
-        std::vector<mge::ecs::Entity> entitiesToDestroy;
+        // destroys wait for the next flush, so bullets and asteroids that have already been hit are still around
+        m_destroyed.clear();
 
         for (const auto& collisionEvent : collisionEvents)
-        if (getComponent(collisionEvent.m_thisEntity))
-        if (auto hitAsteroid = asteroidSystem->getComponent(collisionEvent.m_otherEntity)) {
-            entitiesToDestroy.push_back(collisionEvent.m_thisEntity);
-            entitiesToDestroy.push_back(collisionEvent.m_otherEntity);
+        if (!alreadyDestroyed(collisionEvent.m_thisEntity) && !alreadyDestroyed(collisionEvent.m_otherEntity))
+        if (readComponent(collisionEvent.m_thisEntity))
+        if (auto hitAsteroid = asteroidSystem->readComponent(collisionEvent.m_otherEntity)) {
+            r_ecsManager->m_commandBuffer.destroy(collisionEvent.m_thisEntity);
+            r_ecsManager->m_commandBuffer.destroy(collisionEvent.m_otherEntity);
+            m_destroyed.push_back(collisionEvent.m_thisEntity);
+            m_destroyed.push_back(collisionEvent.m_otherEntity);
 
             asteroidSystem->breakApart(hitAsteroid->m_entity);
         }
-
-        for (auto& entity : entitiesToDestroy) r_ecsManager->destroyEntity(entity);
     }
 };
 
@@ -141,14 +154,14 @@ public:
     constexpr static float ACCELERATION_RATE = 25.f;
     constexpr static float RATE_OF_FIRE = 0.125f;
 
-    void checkForAsteroidCollision(const std::vector<mge::ecs::CollisionEvent>& collisions) {
-        auto asteroidSystem = r_ecsManager->getSystem<AsteroidComponent>("Asteroid");
-        auto rigidbodySystem = r_ecsManager->getSystem<mge::ecs::RigidbodyComponent>("Rigidbody");
+    void checkForAsteroidCollision(std::span<const mge::ecs::CollisionEvent> collisions) {
+        auto asteroidSystem = r_ecsManager->getSystem<AsteroidComponent>();
+        auto rigidbodySystem = r_ecsManager->getSystem<mge::ecs::RigidbodyComponent>();
 
         for (auto& collision : collisions)
         if (auto spaceship = getComponent(collision.m_thisEntity))
         if (spaceship->isAlive())
-        if (asteroidSystem->getComponent(collision.m_otherEntity)) {
+        if (asteroidSystem->readComponent(collision.m_otherEntity)) {
             spaceship->die();
 
             if (auto rigidbody = rigidbodySystem->getComponent(spaceship->m_entity)) {
@@ -159,34 +172,29 @@ public:
     }
 
     void update(float deltaTime, bool accelerate, bool pitchUp, bool pitchDown, bool turnLeft, bool turnRight, bool fire) {
-        auto transformSystem = r_ecsManager->getSystem<mge::ecs::TransformComponent>("Transform");
-        auto rigidbodySystem = r_ecsManager->getSystem<mge::ecs::RigidbodyComponent>("Rigidbody");
-
         static float turnInput = 0.f, pitchInput = 0.f;
 
         turnInput = glm::mix(turnInput, static_cast<float>(turnLeft - turnRight), glm::clamp(2.f * deltaTime, 0.f, 1.f));
         pitchInput = glm::mix(pitchInput, static_cast<float>(pitchDown - pitchUp), glm::clamp(2.f * deltaTime, 0.f, 1.f));
 
-        for (auto& [ entity, comp ] : m_components) {
+        for (auto [ entity, comp, transform, rigidbody ] : r_ecsManager->view<SpaceshipComponent, mge::ecs::TransformComponent, mge::ecs::RigidbodyComponent>()) {
             comp.updateDeathTimer(deltaTime);
 
-            if (comp.isAlive())
-            if (auto transform = transformSystem->getComponent(entity))
-            if (auto rigidbody = rigidbodySystem->getComponent(entity)) {
+            if (comp.isAlive()) {
                 comp.m_fireCooldown = glm::max(0.f, comp.m_fireCooldown - deltaTime);
                 float pitchDelta = pitchInput * PITCH_RATE * deltaTime;
                 float turnDelta = turnInput * TURN_RATE * deltaTime;
 
-                transform->setRotation(
-                    glm::angleAxis(turnDelta, transform->getUp()) *
-                    glm::angleAxis(-0.5f * turnDelta, transform->getForward()) *
-                    glm::angleAxis(pitchDelta, transform->getRight()) *
-                    transform->getRotation()
+                transform.setRotation(
+                    glm::angleAxis(turnDelta, transform.getUp()) *
+                    glm::angleAxis(-0.5f * turnDelta, transform.getForward()) *
+                    glm::angleAxis(pitchDelta, transform.getRight()) *
+                    transform.getRotation()
                 );
 
-                rigidbody->m_velocity *= glm::clamp(1.f - 0.1f * deltaTime, 0.f, 1.f);
-                rigidbody->m_acceleration = transform->getForward() * (ACCELERATION_RATE * accelerate);
-                rigidbody->m_angularVelocity = glm::vec3(0.f);
+                rigidbody.m_velocity *= glm::clamp(1.f - 0.1f * deltaTime, 0.f, 1.f);
+                rigidbody.m_acceleration = transform.getForward() * (ACCELERATION_RATE * accelerate);
+                rigidbody.m_angularVelocity = glm::vec3(0.f);
 
                 static float side = -1.f;
 
@@ -194,15 +202,19 @@ public:
                 if (comp.m_fireCooldown <= 0.f) {
                     comp.m_fireCooldown = RATE_OF_FIRE;
 
-                    auto bulletEntity = r_ecsManager->makeEntityFromTemplate("Bullet");
+                    glm::vec3 bulletPosition = transform.getPosition() + transform.getForward() * 3.f + transform.getRight() * side;
+                    glm::quat bulletRotation = transform.getRotation() * glm::angleAxis(glm::half_pi<float>(), glm::vec3 { 1.f, 0.f, 0.f });
+                    glm::vec3 bulletVelocity = rigidbody.m_velocity + transform.getForward() * 100.f;
 
-                    auto bulletTransform = transformSystem->getComponent(bulletEntity);
-                    auto bulletRigidbody = rigidbodySystem->getComponent(bulletEntity);
+                    r_ecsManager->m_commandBuffer.spawn("Bullet", [=](mge::ecs::ECSManager& ecs, const mge::ecs::Entity& bulletEntity) {
+                        auto bulletTransform = ecs.getSystem<mge::ecs::TransformComponent>()->getComponent(bulletEntity);
+                        auto bulletRigidbody = ecs.getSystem<mge::ecs::RigidbodyComponent>()->getComponent(bulletEntity);
 
-                    bulletTransform->setPosition(transform->getPosition() + transform->getForward() * 3.f + transform->getRight() * side);
-                    bulletTransform->setRotation(transform->getRotation() * glm::angleAxis(glm::half_pi<float>(), glm::vec3 { 1.f, 0.f, 0.f }));
+                        bulletTransform->setPosition(bulletPosition);
+                        bulletTransform->setRotation(bulletRotation);
 
-                    bulletRigidbody->m_velocity = rigidbody->m_velocity + transform->getForward() * 100.f;
+                        bulletRigidbody->m_velocity = bulletVelocity;
+                    });
 
                     side *= -1.f;
                 }
@@ -8,6 +8,7 @@
 #include <taa.hpp>
 #include <bloom.hpp>
 
+#include <array>
 #include <vector>
 #include <string>
 
@@ -17,7 +18,7 @@ class Sponza : public mge::Engine {
 
     mge::ecs::ModelSystem m_modelSystem;
     mge::ecs::LightSystem m_lightSystem;
-    mge::ecs::System<mge::ecs::TransformComponent> m_transformSystem;
+    mge::ecs::TransformSystem m_transformSystem;
     
     typedef mge::Model<
         mge::ModelVertex,
@@ -98,8 +99,26 @@ class Sponza : public mge::Engine {
 
         m_models.reserve(m_modelNames.size());
 
-        for (const auto& modelName : m_modelNames) {
-            auto mesh = std::make_unique<Model::Mesh>(mge::loadObjMesh(*this, ("assets/sponza/" + modelName + ".obj").c_str()));
+        // parsing the OBJ files and decoding the textures doesn't touch vulkan, so it can all happen in parallel
+        std::vector<std::unique_ptr<Model::Mesh>> loadedMeshes(m_modelNames.size());
+        std::vector<std::array<mge::Texture, 3>> loadedTextures(m_modelNames.size());
+
+        m_jobSystem.parallelFor(0, m_modelNames.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const auto& modelName = m_modelNames[i];
+
+                loadedMeshes[i] = std::make_unique<Model::Mesh>(mge::loadObjMesh(*this, ("assets/sponza/" + modelName + ".obj").c_str()));
+                loadedTextures[i] = {
+                    mge::Texture(("assets/sponza/" + modelName + "Albedo.png").c_str()),
+                    mge::Texture(("assets/sponza/" + modelName + "ARM.png").c_str(), vk::Format::eR8G8B8A8Unorm),
+                    mge::Texture(("assets/sponza/" + modelName + "Normal.png").c_str(), vk::Format::eR8G8B8A8Unorm),
+                };
+            }
+        });
+
+        for (size_t i = 0; i < m_modelNames.size(); i++) {
+            const auto& modelName = m_modelNames[i];
+            auto mesh = std::move(loadedMeshes[i]);
             Model::Material* material;
 
             if (modelName == "Chains" || modelName == "Ivy" || modelName == "Plants") {
@@ -110,12 +129,7 @@ class Sponza : public mge::Engine {
 
             auto materialInstance = std::make_unique<Model::Material::Instance>(material->makeInstance());
 
-            mge::Texture
-                albedoTexture(("assets/sponza/" + modelName + "Albedo.png").c_str()),
-                armTexture(("assets/sponza/" + modelName + "ARM.png").c_str(), vk::Format::eR8G8B8A8Unorm),
-                normalTexture(("assets/sponza/" + modelName + "Normal.png").c_str(), vk::Format::eR8G8B8A8Unorm);
-
-            materialInstance->setup({ albedoTexture, armTexture, normalTexture });
+            materialInstance->setup(loadedTextures[i]);
 
             m_meshes.push_back(std::move(mesh));
 
@@ -269,6 +283,7 @@ class Sponza : public mge::Engine {
     }
 
     void update(double deltaTime) override {
+        m_ecsManager.advanceTick();
         updateCameraPosition(deltaTime);
     }
 
@@ -362,14 +377,12 @@ class Sponza : public mge::Engine {
         m_camera->m_position = cameraTransform->getPosition();
         m_camera->m_forward = cameraTransform->getForward();
         m_camera->m_up = cameraTransform->getUp();
-
-        // auto spotLightTransform = m_transformSystem.getComponent(m_spotLightEntity);
-        // spotLightTransform->setPosition(cameraTransform->getPosition() + cameraTransform->getForward() * 0.25f);
-        // spotLightTransform->setRotation(cameraTransform->getRotation());
     }
 
     void updateBuffers() override {
         m_camera->updateBuffer();
+        m_transformSystem.updateMatrices(&m_jobSystem);
+        m_transformSystem.swapBuffers();
         m_modelSystem.updateTransforms();
         m_lightSystem.update();
     }
@@ -89,6 +89,8 @@ void Engine::main() {
         double time = static_cast<double>(microsSinceStart) / 1'000'000.f;
         double deltaTime = static_cast<double>(microsSinceLastFrame) / 1'000'000.f;
         
+        m_frameArena.reset();
+
         glfwPollEvents();
         physicsUpdate(deltaTime);
         update(deltaTime);
@@ -0,0 +1,381 @@
+#ifndef ARCHETYPE_HPP
+#define ARCHETYPE_HPP
+
+#include <component.hpp>
+#include <entity.hpp>
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mge::ecs {
+
+/**
+ * @brief Optional storage that keeps entities with identical component sets together
+ *
+ * Every distinct set of component types is an archetype, and each archetype stores its entities in fixed size
+ * chunks laid out as structure of arrays: the entity handles first, then one array per component type. A
+ * query walks the matching archetypes chunk by chunk and streams through their arrays, with no per-entity
+ * lookups to join components together:
+ *
+ *     storage.each<TransformComponent, RigidbodyComponent>([](const Entity& entity, auto& transform, auto& rigidbody) { ... });
+ *
+ * Adding or removing a component moves the entity to the archetype for its new component set. Removal fills
+ * the hole with the archetype's last entity, so as with systems, pointers are only valid until the next
+ * add or remove. Components stored here don't go through any system, so they have no change versions.
+ */
+class ArchetypeStorage {
+public:
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+    static constexpr size_t CHUNK_ALIGNMENT = 64;
+
+private:
+    // what's needed to move and destroy components of a type without knowing the type
+    struct ComponentInfo {
+        size_t m_size = 0;
+        size_t m_alignment = 0;
+        void (*m_moveConstruct)(void* destination, void* source) = nullptr;
+        void (*m_destroy)(void* component) = nullptr;
+    };
+
+    struct ChunkDeleter {
+        void operator()(std::byte* data) const { ::operator delete(data, std::align_val_t { CHUNK_ALIGNMENT }); }
+    };
+
+    struct Chunk {
+        std::unique_ptr<std::byte, ChunkDeleter> m_data;
+        uint32_t m_count = 0;
+
+        Entity* entities() { return reinterpret_cast<Entity*>(m_data.get()); }
+    };
+
+    struct Archetype {
+        Signature m_signature = 0;
+        uint32_t m_capacity = 0;
+
+        // parallel arrays, one entry per component type in ascending type ID order
+        std::vector<ComponentTypeID> m_types;
+        std::vector<size_t> m_offsets;
+        std::vector<size_t> m_sizes;
+        std::vector<size_t> m_alignments;
+
+        // the column of each component type ID, or -1
+        std::array<int8_t, MAX_COMPONENT_TYPES> m_columns;
+
+        // the archetypes reached by adding or removing each component type, filled in as they're used
+        std::array<Archetype*, MAX_COMPONENT_TYPES> m_addEdges {};
+        std::array<Archetype*, MAX_COMPONENT_TYPES> m_removeEdges {};
+
+        std::vector<Chunk> m_chunks;
+
+        std::byte* at(Chunk& chunk, size_t column, uint32_t row) {
+            return chunk.m_data.get() + m_offsets[column] + row * m_sizes[column];
+        }
+    };
+
+    struct Location {
+        Entity m_entity;
+        Archetype* r_archetype = nullptr;
+        uint32_t m_chunk = 0, m_row = 0;
+    };
+
+    std::array<ComponentInfo, MAX_COMPONENT_TYPES> m_componentInfos;
+    std::unordered_map<Signature, std::unique_ptr<Archetype>> m_archetypes;
+    std::vector<Archetype*> m_archetypeList;
+
+    // indexed by entity index
+    std::vector<Location> m_locations;
+
+    template<typename Component>
+    ComponentTypeID registerComponent() {
+        ComponentTypeID typeID = getComponentTypeID<Component>();
+        if (typeID >= MAX_COMPONENT_TYPES)
+            throw std::runtime_error("Component type ID too large to be stored by archetype");
+
+        static_assert(alignof(Component) <= CHUNK_ALIGNMENT, "Component is too strictly aligned to be stored by archetype");
+
+        auto& info = m_componentInfos[typeID];
+        if (!info.m_size) info = ComponentInfo {
+            sizeof(Component), alignof(Component),
+            [](void* destination, void* source) { new (destination) Component(std::move(*static_cast<Component*>(source))); },
+            [](void* component) { static_cast<Component*>(component)->~Component(); },
+        };
+
+        return typeID;
+    }
+
+    static size_t alignUp(size_t offset, size_t alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    // lays out the archetype's columns for the given number of rows, returning the bytes used
+    static size_t layout(Archetype& archetype, uint32_t capacity) {
+        size_t offset = sizeof(Entity) * capacity;
+
+        for (size_t column = 0; column < archetype.m_types.size(); column++) {
+            offset = alignUp(offset, archetype.m_alignments[column]);
+            archetype.m_offsets[column] = offset;
+            offset += archetype.m_sizes[column] * capacity;
+        }
+
+        return offset;
+    }
+
+    Archetype& getArchetype(Signature signature) {
+        auto& archetype = m_archetypes[signature];
+        if (archetype) return *archetype;
+
+        archetype = std::make_unique<Archetype>();
+        archetype->m_signature = signature;
+        archetype->m_columns.fill(-1);
+
+        size_t rowSize = sizeof(Entity);
+        for (Signature remaining = signature; remaining; remaining &= remaining - 1) {
+            ComponentTypeID typeID = std::countr_zero(remaining);
+            const auto& info = m_componentInfos[typeID];
+
+            archetype->m_columns[typeID] = static_cast<int8_t>(archetype->m_types.size());
+            archetype->m_types.push_back(typeID);
+            archetype->m_sizes.push_back(info.m_size);
+            archetype->m_alignments.push_back(info.m_alignment);
+            rowSize += info.m_size;
+        }
+
+        archetype->m_offsets.resize(archetype->m_types.size());
+
+        // padding between columns can push the first guess over, so back off until everything fits
+        uint32_t capacity = static_cast<uint32_t>(CHUNK_SIZE / rowSize);
+        while (capacity > 0 && layout(*archetype, capacity) > CHUNK_SIZE) capacity--;
+
+        if (capacity == 0) throw std::runtime_error("Components are too large to fit one entity in an archetype chunk");
+        archetype->m_capacity = capacity;
+
+        m_archetypeList.push_back(archetype.get());
+        return *archetype;
+    }
+
+    Archetype& getNeighbour(Archetype* archetype, ComponentTypeID typeID, bool adding) {
+        Signature signature = archetype ? archetype->m_signature : 0;
+        Signature bit = Signature { 1 } << typeID;
+
+        if (!archetype) return getArchetype(signature | bit);
+
+        auto& edge = adding ? archetype->m_addEdges[typeID] : archetype->m_removeEdges[typeID];
+        if (!edge) edge = &getArchetype(adding ? signature | bit : signature & ~bit);
+        return *edge;
+    }
+
+    // appends an uninitialised row to the archetype, making a new chunk if the last one is full
+    std::pair<uint32_t, uint32_t> allocateRow(Archetype& archetype, const Entity& entity) {
+        if (archetype.m_chunks.empty() || archetype.m_chunks.back().m_count == archetype.m_capacity) {
+            Chunk chunk;
+            chunk.m_data.reset(static_cast<std::byte*>(::operator new(CHUNK_SIZE, std::align_val_t { CHUNK_ALIGNMENT })));
+            archetype.m_chunks.push_back(std::move(chunk));
+        }
+
+        uint32_t chunkIndex = static_cast<uint32_t>(archetype.m_chunks.size() - 1);
+        Chunk& chunk = archetype.m_chunks.back();
+        uint32_t row = chunk.m_count++;
+
+        chunk.entities()[row] = entity;
+        return { chunkIndex, row };
+    }
+
+    // fills a row whose components have already been moved out or destroyed with the archetype's last row
+    void releaseRow(Archetype& archetype, uint32_t chunkIndex, uint32_t row) {
+        Chunk& last = archetype.m_chunks.back();
+        uint32_t lastRow = last.m_count - 1;
+
+        if (&archetype.m_chunks[chunkIndex] != &last || row != lastRow) {
+            Chunk& chunk = archetype.m_chunks[chunkIndex];
+
+            for (size_t column = 0; column < archetype.m_types.size(); column++) {
+                void* source = archetype.at(last, column, lastRow);
+                m_componentInfos[archetype.m_types[column]].m_moveConstruct(archetype.at(chunk, column, row), source);
+                m_componentInfos[archetype.m_types[column]].m_destroy(source);
+            }
+
+            Entity moved = last.entities()[lastRow];
+            chunk.entities()[row] = moved;
+            m_locations[moved.m_index].m_chunk = chunkIndex;
+            m_locations[moved.m_index].m_row = row;
+        }
+
+        if (--last.m_count == 0) archetype.m_chunks.pop_back();
+    }
+
+    // moves the entity's shared components into target, destroying any target doesn't have
+    void migrate(Location& location, Archetype& target) {
+        Archetype* source = location.r_archetype;
+        auto [ chunkIndex, row ] = allocateRow(target, location.m_entity);
+
+        if (source) {
+            Chunk& sourceChunk = source->m_chunks[location.m_chunk];
+            Chunk& targetChunk = target.m_chunks[chunkIndex];
+
+            for (size_t column = 0; column < source->m_types.size(); column++) {
+                ComponentTypeID typeID = source->m_types[column];
+                void* component = source->at(sourceChunk, column, location.m_row);
+
+                if (target.m_columns[typeID] >= 0)
+                    m_componentInfos[typeID].m_moveConstruct(target.at(targetChunk, target.m_columns[typeID], row), component);
+                m_componentInfos[typeID].m_destroy(component);
+            }
+
+            releaseRow(*source, location.m_chunk, location.m_row);
+        }
+
+        location.r_archetype = &target;
+        location.m_chunk = chunkIndex;
+        location.m_row = row;
+    }
+
+    Location* find(const Entity& entity) {
+        if (entity.m_index >= m_locations.size()) return nullptr;
+
+        Location& location = m_locations[entity.m_index];
+        if (!location.r_archetype || location.m_entity != entity) return nullptr;
+        return &location;
+    }
+
+    template<typename Component>
+    Component* column(Archetype& archetype, Chunk& chunk) {
+        return reinterpret_cast<Component*>(archetype.at(chunk, archetype.m_columns[getComponentTypeID<Component>()], 0));
+    }
+
+    template<typename... Components>
+    static Signature mask() {
+        return ((Signature { 1 } << getComponentTypeID<Components>()) | ... | Signature { 0 });
+    }
+
+public:
+    ArchetypeStorage() = default;
+    ArchetypeStorage(const ArchetypeStorage&) = delete;
+    ArchetypeStorage& operator=(const ArchetypeStorage&) = delete;
+
+    ~ArchetypeStorage() { clear(); }
+
+    // moves the entity to its new archetype, returning the existing component if it already has one
+    template<typename Component>
+    Component& add(const Entity& entity, Component component = {}) {
+        ComponentTypeID typeID = registerComponent<Component>();
+
+        if (entity.m_index >= m_locations.size()) m_locations.resize(entity.m_index + 1);
+
+        Location* location = find(entity);
+        if (location && location->r_archetype->m_columns[typeID] >= 0) return *get<Component>(entity);
+
+        if (!location) {
+            location = &m_locations[entity.m_index];
+
+            // a row left behind by an older entity with the same index
+            if (location->r_archetype) destroy(location->m_entity);
+
+            location->m_entity = entity;
+            location->r_archetype = nullptr;
+        }
+
+        Archetype& target = getNeighbour(location->r_archetype, typeID, true);
+        migrate(*location, target);
+
+        void* destination = target.at(target.m_chunks[location->m_chunk], target.m_columns[typeID], location->m_row);
+        return *new (destination) Component(std::move(component));
+    }
+
+    template<typename Component>
+    void remove(const Entity& entity) {
+        ComponentTypeID typeID = getComponentTypeID<Component>();
+
+        Location* location = find(entity);
+        if (!location || typeID >= MAX_COMPONENT_TYPES || location->r_archetype->m_columns[typeID] < 0) return;
+
+        if (location->r_archetype->m_signature == (Signature { 1 } << typeID)) {
+            destroy(entity);
+            return;
+        }
+
+        migrate(*location, getNeighbour(location->r_archetype, typeID, false));
+    }
+
+    // destroys every component the entity has here
+    void destroy(const Entity& entity) {
+        Location* location = find(entity);
+        if (!location) return;
+
+        Archetype& archetype = *location->r_archetype;
+        Chunk& chunk = archetype.m_chunks[location->m_chunk];
+
+        for (size_t column = 0; column < archetype.m_types.size(); column++)
+            m_componentInfos[archetype.m_types[column]].m_destroy(archetype.at(chunk, column, location->m_row));
+
+        releaseRow(archetype, location->m_chunk, location->m_row);
+        location->r_archetype = nullptr;
+    }
+
+    bool contains(const Entity& entity) { return find(entity) != nullptr; }
+
+    template<typename Component>
+    Component* get(const Entity& entity) {
+        Location* location = find(entity);
+        ComponentTypeID typeID = getComponentTypeID<Component>();
+        if (!location || typeID >= MAX_COMPONENT_TYPES) return nullptr;
+
+        Archetype& archetype = *location->r_archetype;
+        int8_t columnIndex = archetype.m_columns[typeID];
+        if (columnIndex < 0) return nullptr;
+
+        return reinterpret_cast<Component*>(archetype.at(archetype.m_chunks[location->m_chunk], columnIndex, location->m_row));
+    }
+
+    // calls func(count, entities, components...) once per chunk holding all of the components, with each
+    // argument pointing to an array of count elements
+    template<typename... Components, typename Func>
+    void eachChunk(Func&& func) {
+        Signature required = mask<Components...>();
+
+        for (Archetype* archetype : m_archetypeList)
+        if ((archetype->m_signature & required) == required)
+        for (Chunk& chunk : archetype->m_chunks)
+            func(static_cast<size_t>(chunk.m_count), static_cast<const Entity*>(chunk.entities()), column<Components>(*archetype, chunk)...);
+    }
+
+    // calls func(entity, components...) for every entity that has all of the components
+    template<typename... Components, typename Func>
+    void each(Func&& func) {
+        eachChunk<Components...>([&](size_t count, const Entity* entities, Components*... columns) {
+            for (size_t row = 0; row < count; row++)
+                func(entities[row], columns[row]...);
+        });
+    }
+
+    size_t getArchetypeCount() const { return m_archetypeList.size(); }
+
+    size_t getChunkCount() const {
+        size_t result = 0;
+        for (const Archetype* archetype : m_archetypeList) result += archetype->m_chunks.size();
+        return result;
+    }
+
+    void clear() {
+        for (Archetype* archetype : m_archetypeList)
+        for (Chunk& chunk : archetype->m_chunks)
+        for (size_t column = 0; column < archetype->m_types.size(); column++)
+        for (uint32_t row = 0; row < chunk.m_count; row++)
+            m_componentInfos[archetype->m_types[column]].m_destroy(archetype->at(chunk, column, row));
+
+        m_archetypes.clear();
+        m_archetypeList.clear();
+        m_locations.clear();
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,241 @@
+#ifndef BROADPHASE_HPP
+#define BROADPHASE_HPP
+
+#include <collision.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_set>
+#include <vector>
+
+namespace mge::ecs {
+
+/**
+ * @brief Finds the pairs of colliders that might be touching, for CollisionSystem to test properly
+ *
+ * Implementations can keep whatever they like between steps, components have m_broadphaseProxy for a handle back
+ * into it. It follows the component when storage is reordered, but a copied or reloaded component can bring a
+ * stale one with it, so it has to be checked before it's trusted.
+ */
+class Broadphase {
+public:
+    virtual ~Broadphase() = default;
+
+    // adds every unordered pair of components whose AABBs overlap exactly once, the cache is up to date
+    virtual void findPairs(CollisionSystem& system, std::pmr::vector<CollisionPair>& pairs) = 0;
+};
+
+/**
+ * @brief A bounding volume hierarchy that's kept between steps rather than rebuilt
+ *
+ * Each collider is a leaf with a fat AABB, its own grown by the margin on every side. Only a collider that moves
+ * out of its fat AABB is taken out and put back in, everything else leaves the tree alone. Leaves are inserted
+ * next to whichever sibling grows the tree's surface area the least, and the ancestors of a changed leaf are
+ * rotated to keep the tree balanced as they're refit. Pairs are found by walking the tree against itself, so
+ * every pair of overlapping subtrees is only visited once.
+ */
+class DynamicAABBTree : public Broadphase {
+    static constexpr int32_t NULL_NODE = -1;
+
+    struct Node {
+        AABB m_box;
+
+        // the next free node instead, while this one is free
+        int32_t m_parent = NULL_NODE;
+        int32_t m_left = NULL_NODE, m_right = NULL_NODE;
+
+        // leaves are 0, free nodes are -1
+        int32_t m_height = -1;
+
+        // only used by leaves, m_stamp is the last step the collider was seen in
+        Entity m_entity;
+        uint32_t m_slot = 0;
+        uint32_t m_stamp = 0;
+
+        bool isLeaf() const { return m_left == NULL_NODE; }
+    };
+
+    std::vector<Node> m_nodes;
+    int32_t m_root = NULL_NODE;
+    int32_t m_free = NULL_NODE;
+
+    uint32_t m_stamp = 0;
+    size_t m_leafCount = 0;
+    size_t m_movedCount = 0;
+
+    // each component's own AABB this step, by slot, to check leaves against once their fat AABBs overlap
+    const AABB* r_boxes = nullptr;
+
+    int32_t allocateNode();
+    void freeNode(int32_t node);
+
+    void insertLeaf(int32_t leaf);
+    void removeLeaf(int32_t leaf);
+
+    // refits and rebalances every ancestor from node up to the root
+    void fixUpwards(int32_t node);
+    int32_t balance(int32_t node);
+
+    // two subtrees to find overlapping leaves between, or one subtree against itself if they're the same
+    struct NodePair {
+        int32_t m_a, m_b;
+    };
+
+    // adds the pairs of subtrees one level down that could still overlap, false if they're two touching leaves
+    bool descend(NodePair pair, std::pmr::vector<NodePair>& pairs) const;
+    void collide(NodePair pair, std::pmr::vector<CollisionPair>& pairs) const;
+
+public:
+    float m_margin;
+
+    DynamicAABBTree(float margin = 1.f) : m_margin(margin) {}
+
+    void findPairs(CollisionSystem& system, std::pmr::vector<CollisionPair>& pairs) override;
+
+    int32_t getHeight() const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].m_height; }
+    size_t getLeafCount() const { return m_leafCount; }
+
+    // how many colliders were inserted or left their fat AABB in the last step
+    size_t getMovedCount() const { return m_movedCount; }
+};
+
+/**
+ * @brief Keeps every collider's AABB endpoints sorted along each axis between steps
+ *
+ * Colliders that move a little only swap places with their neighbours, so insertion sort puts the endpoints back
+ * in order in close to linear time. Whenever the start of one AABB passes the end of another the pair might have
+ * started overlapping, and whenever an end passes a start they've stopped, so the set of overlapping pairs is
+ * kept up to date from the swaps alone rather than found again every step. The pairs that started and stopped
+ * overlapping in the last step are kept as well.
+ *
+ * Works best when colliders are small compared to the space between them and don't move far in a step. Adding a
+ * lot of colliders at once sorts everything from scratch instead.
+ */
+class SweepAndPrune : public Broadphase {
+public:
+    struct EntityPair {
+        Entity m_a, m_b;
+    };
+
+private:
+    static constexpr int32_t NULL_PROXY = -1;
+
+    // more new colliders than this in a step and it's quicker to sort from scratch than sort each one in
+    static constexpr size_t MAX_SORTED_IN = 16;
+
+    struct Proxy {
+        AABB m_box;
+        Entity m_entity;
+        uint32_t m_slot = 0;
+        uint32_t m_stamp = 0;
+
+        // the next free proxy, while this one is free
+        int32_t m_next = NULL_PROXY;
+        bool m_used = false;
+    };
+
+    struct Endpoint {
+        float m_value;
+        uint32_t m_proxy;
+        bool m_isMax;
+
+        // a start comes before an end at the same place, so AABBs that only touch still overlap
+        bool precedes(const Endpoint& other) const {
+            return m_value < other.m_value || (m_value == other.m_value && !m_isMax && other.m_isMax);
+        }
+    };
+
+    std::vector<Proxy> m_proxies;
+    int32_t m_free = NULL_PROXY;
+    uint32_t m_stamp = 0;
+
+    std::vector<Endpoint> m_endpoints[3];
+
+    // overlapping pairs of proxies, the lower index in the high half
+    std::unordered_set<uint64_t> m_pairs;
+
+    std::vector<EntityPair> m_added, m_removed;
+
+    // scratch space for findPairs and rebuild, kept between steps so it's only allocated as it grows
+    std::vector<uint32_t> m_addedProxies, m_open;
+    std::unordered_set<uint64_t> m_rebuiltPairs;
+
+    static uint64_t pairKey(uint32_t a, uint32_t b) {
+        return static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+    }
+
+    static float minOf(const AABB& box, int axis) { return axis == 0 ? box.m_minX : axis == 1 ? box.m_minY : box.m_minZ; }
+    static float maxOf(const AABB& box, int axis) { return axis == 0 ? box.m_maxX : axis == 1 ? box.m_maxY : box.m_maxZ; }
+
+    uint32_t allocateProxy();
+    void freeProxy(uint32_t proxy);
+
+    void addPair(uint32_t a, uint32_t b);
+    void removePair(uint32_t a, uint32_t b);
+
+    // brings the endpoints up to date, drops freed proxies' and appends the new ones', then sorts them back in
+    void sortAxis(int axis, const std::vector<uint32_t>& added);
+    void rebuild();
+
+public:
+    void findPairs(CollisionSystem& system, std::pmr::vector<CollisionPair>& pairs) override;
+
+    const std::vector<EntityPair>& getAddedPairs() const { return m_added; }
+    const std::vector<EntityPair>& getRemovedPairs() const { return m_removed; }
+};
+
+/**
+ * @brief Bins colliders into a grid of equal cells, hashed so the space doesn't need bounds
+ *
+ * Each collider goes in the cell its AABB's centre is in, sorted by cell with a counting sort so the colliders in
+ * one cell are next to each other. Every cell is only tested against itself and the 13 neighbours on one side of
+ * it, the other 13 test it in turn. Cells are grown to fit the largest AABB each step, so overlapping colliders are
+ * never more than one cell apart.
+ *
+ * With a period the space wraps around, a collider at one end of it touches colliders at the other. The period
+ * has to be the same on every axis and at least three cells across, and the pairs found across the boundary
+ * have an offset to move one of them next to the other. It only makes sense for colliders without a parent
+ * transform, like the asteroids that AsteroidSystem::wrapAsteroids keeps in a box.
+ */
+class UniformGrid : public Broadphase {
+    struct Entry {
+        AABB m_box;
+        int32_t m_cell[3];
+        uint32_t m_slot;
+        uint32_t m_bucket;
+    };
+
+    // the cell size and cells per period used this step, which might differ from what was asked for
+    float m_size = 0.f;
+    int32_t m_cellsPerPeriod = 0;
+
+    // entries are binned into m_binned by slot, then sorted into m_entries by bucket
+    std::vector<Entry> m_binned, m_entries;
+    std::vector<uint32_t> m_bucketStarts;
+    uint32_t m_bucketMask = 0;
+
+    int32_t cellOf(float position) const;
+    int32_t wrapCell(int32_t cell) const;
+    uint32_t bucketOf(const int32_t cell[3]) const;
+
+    // tests an entry against the rest of its cell, and the cells on one side of it
+    void scan(uint32_t entry, std::pmr::vector<CollisionPair>& pairs) const;
+    void testPair(const Entry& a, const Entry& b, std::pmr::vector<CollisionPair>& pairs) const;
+
+public:
+    float m_cellSize;
+
+    // 0 for space that doesn't wrap
+    float m_period;
+
+    UniformGrid(float cellSize, float period = 0.f) : m_cellSize(cellSize), m_period(period) {}
+
+    void findPairs(CollisionSystem& system, std::pmr::vector<CollisionPair>& pairs) override;
+
+    float getCellSize() const { return m_size; }
+};
+
+}
+
+#endif
@@ -5,15 +5,36 @@
 #include <system.hpp>
 #include <ecsManager.hpp>
 #include <transform.hpp>
+#include <jobSystem.hpp>
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
 
 namespace mge::ecs {
 
+// every collision gives one event for each entity, the normal is the way that entity has to move to get out
 struct CollisionEvent {
     Entity m_thisEntity, m_otherEntity;
     glm::vec3 m_normal, m_collisionPoint;
     float m_collisionDepth;
+
+    // the other entity's event for the same collision
+    CollisionEvent mirror() const {
+        return CollisionEvent { m_otherEntity, m_thisEntity, -m_normal, m_collisionPoint, m_collisionDepth };
+    }
+};
+
+// two slots in CollisionSystem::m_components whose AABBs overlap, the lower one first
+struct CollisionPair {
+    uint32_t m_a, m_b;
+
+    // added to b's position to bring it next to a, when they only touch across a periodic boundary
+    glm::vec3 m_offset { 0.f };
+
+    bool operator==(const CollisionPair& other) const { return m_a == other.m_a && m_b == other.m_b; }
+    bool operator<(const CollisionPair& other) const { return m_a < other.m_a || (m_a == other.m_a && m_b < other.m_b); }
 };
 
 struct AABB {
@@ -21,15 +42,92 @@ struct AABB {
     float m_minY, m_maxY;
     float m_minZ, m_maxZ;
 
-    bool checkIntersection(const AABB& other) const;
+    bool checkIntersection(const AABB& other) const {
+        bool xIntersection = !(m_maxX < other.m_minX || m_minX > other.m_maxX);
+        bool yIntersection = !(m_maxY < other.m_minY || m_minY > other.m_maxY);
+        bool zIntersection = !(m_maxZ < other.m_minZ || m_minZ > other.m_maxZ);
+        return xIntersection && yIntersection && zIntersection;
+    }
+
+    bool contains(const AABB& other) const {
+        return m_minX <= other.m_minX && m_maxX >= other.m_maxX
+            && m_minY <= other.m_minY && m_maxY >= other.m_maxY
+            && m_minZ <= other.m_minZ && m_maxZ >= other.m_maxZ;
+    }
+
+    AABB merge(const AABB& other) const {
+        return AABB {
+            std::min(m_minX, other.m_minX), std::max(m_maxX, other.m_maxX),
+            std::min(m_minY, other.m_minY), std::max(m_maxY, other.m_maxY),
+            std::min(m_minZ, other.m_minZ), std::max(m_maxZ, other.m_maxZ),
+        };
+    }
+
+    AABB expand(float margin) const {
+        return AABB {
+            m_minX - margin, m_maxX + margin,
+            m_minY - margin, m_maxY + margin,
+            m_minZ - margin, m_maxZ + margin,
+        };
+    }
+
+    float getSurfaceArea() const {
+        float x = m_maxX - m_minX, y = m_maxY - m_minY, z = m_maxZ - m_minZ;
+        return 2.f * (x * y + y * z + z * x);
+    }
+};
+
+/**
+ * @brief Every collider's world space shape for one step, worked out once rather than by every test that needs it
+ *
+ * Each kind of data has an array of its own. Boxes and positions are by slot in CollisionSystem::m_components,
+ * everything else only has entries for the colliders that use it, at the collider's m_cacheIndex.
+ */
+struct ColliderCache {
+    std::vector<AABB> m_boxes;
+    std::vector<glm::vec3> m_positions;
+
+    // OBBs' corners, and their forward, up and right axes
+    std::vector<std::array<glm::vec3, 8>> m_corners;
+    std::vector<std::array<glm::vec3, 3>> m_axes;
+
+    // the top and bottom of capsules' segments
+    std::vector<std::array<glm::vec3, 2>> m_segments;
 };
 
 class Collider {
 public:
-    TransformComponent* r_transform;
+    // which subclass this is, so pairs can be tested without going through virtual calls
+    enum Type : uint8_t {
+        e_sphere = 0,
+        e_capsule,
+        e_obb,
+        e_typeCount,
+    };
+
+    Type m_type;
+    const TransformComponent* r_transform;
 
+    // set while CollisionSystem::getCollisionEvents runs, so the collider reads its shape from there
+    const ColliderCache* r_cache = nullptr;
+    uint32_t m_cacheSlot = 0;
+    uint32_t m_cacheIndex = 0;
+
+    Collider(Type type) : m_type(type) {}
     virtual ~Collider() = default;
 
+    // makes room in the cache for anything besides a box and a position, and returns where it is
+    virtual uint32_t reserveCache(ColliderCache&) const { return 0; }
+
+    // works out the collider's world space shape from its transform
+    virtual void fillCache(ColliderCache& cache) const {
+        cache.m_positions[m_cacheSlot] = r_transform->getWorldPosition();
+        cache.m_boxes[m_cacheSlot] = computeAABB();
+    }
+
+    glm::vec3 getPosition() const { return r_cache ? r_cache->m_positions[m_cacheSlot] : r_transform->getWorldPosition(); }
+    AABB getAABB() const { return r_cache ? r_cache->m_boxes[m_cacheSlot] : computeAABB(); }
+
     /**
      * @brief Get the Support Point for the object
      * 
@@ -38,12 +136,15 @@ public:
      */
     virtual glm::vec3 getSupportPoint(const glm::vec3& direction) const = 0;
     virtual glm::vec3 getClosestPoint(const glm::vec3& position) const = 0;
-    virtual void addNormalsToVector(std::vector<glm::vec3>& normals, const Collider& other) const = 0;
+    virtual void addNormalsToVector(std::pmr::vector<glm::vec3>& normals, const Collider& other) const = 0;
 
-    virtual AABB getAABB() const = 0;
+    virtual AABB computeAABB() const = 0;
 
     bool checkCollisionAlongDirection(const Collider& other, const glm::vec3& normal, CollisionEvent& event) const;
     bool checkCollisionSAT(const Collider& other, CollisionEvent& event) const;
+
+    // the exact test for this pair of types, for colliders whose AABBs are already known to overlap
+    bool checkShapes(const Collider& other, CollisionEvent& event) const;
     bool checkCollision(const Collider& other, CollisionEvent& event) const;
 };
 
@@ -51,12 +152,12 @@ class SphereCollider : public Collider {
 public:
     float m_radius;
 
-    SphereCollider(float radius) : m_radius(radius) {}
+    SphereCollider(float radius) : Collider(e_sphere), m_radius(radius) {}
 
-    AABB getAABB() const override;
+    AABB computeAABB() const override;
     glm::vec3 getSupportPoint(const glm::vec3& direction) const override;
     glm::vec3 getClosestPoint(const glm::vec3& position) const override;
-    void addNormalsToVector(std::vector<glm::vec3>& normals, const Collider& other) const override;
+    void addNormalsToVector(std::pmr::vector<glm::vec3>& normals, const Collider& other) const override;
 };
 
 class CapsuleCollider : public Collider {
@@ -64,12 +165,17 @@ public:
     float m_radius;
     float m_halfHeight;
 
-    CapsuleCollider(float radius, float halfHeight) : m_radius(radius), m_halfHeight(halfHeight) {}
+    CapsuleCollider(float radius, float halfHeight) : Collider(e_capsule), m_radius(radius), m_halfHeight(halfHeight) {}
+
+    std::array<glm::vec3, 2> getSegment() const;
+
+    uint32_t reserveCache(ColliderCache& cache) const override;
+    void fillCache(ColliderCache& cache) const override;
 
-    AABB getAABB() const override;
+    AABB computeAABB() const override;
     glm::vec3 getSupportPoint(const glm::vec3& direction) const override;
     glm::vec3 getClosestPoint(const glm::vec3& position) const override;
-    void addNormalsToVector(std::vector<glm::vec3>& normals, const Collider& other) const override;
+    void addNormalsToVector(std::pmr::vector<glm::vec3>& normals, const Collider& other) const override;
 };
 
 class OBBCollider : public Collider {
@@ -79,6 +185,7 @@ public:
     float m_depth;
 
     OBBCollider(float width, float height, float depth) :
+        Collider(e_obb),
         m_width(width),
         m_height(height),
         m_depth(depth)
@@ -87,17 +194,23 @@ public:
     std::array<glm::vec3, 8> getModelSpaceCorners() const;
     std::array<glm::vec3, 8> getWorldSpaceCorners() const;
 
-    AABB getAABB() const override;
+    uint32_t reserveCache(ColliderCache& cache) const override;
+    void fillCache(ColliderCache& cache) const override;
+
+    AABB computeAABB() const override;
     glm::vec3 getSupportPoint(const glm::vec3& direction) const override;
     glm::vec3 getClosestPoint(const glm::vec3& position) const override;
-    void addNormalsToVector(std::vector<glm::vec3>& normals, const Collider& other) const override;
+    void addNormalsToVector(std::pmr::vector<glm::vec3>& normals, const Collider& other) const override;
 };
 
 class CollisionComponent : public Component {
 public:
-    TransformComponent* r_transform;
+    const TransformComponent* r_transform;
     std::unique_ptr<Collider> m_collider;
 
+    // the broadphase's handle for this collider, if it keeps one between steps
+    int32_t m_broadphaseProxy = -1;
+
     template<typename ColliderType>
     void setCollider(ColliderType collider) {
         m_collider = std::make_unique<ColliderType>(collider);
@@ -113,12 +226,20 @@ public:
     }
 };
 
+class Broadphase;
+
 class CollisionSystem : public System<CollisionComponent> {
+    // runs narrowphase once for a pair whose AABBs overlap, and adds an event for each side of the collision if there is one
+    static void testPair(const CollisionComponent& a, const CollisionComponent& b, const glm::vec3& offset, std::pmr::vector<CollisionEvent>& events);
+
 public:
+    // nodes and their child lists come from the memory resource the tree was made with
     class BSPT {
     public:
-        std::unique_ptr<BSPT> m_left, m_right;
-        std::vector<CollisionComponent*> m_children;
+        std::pmr::memory_resource* r_memory;
+        BSPT* m_left = nullptr;
+        BSPT* m_right = nullptr;
+        std::pmr::vector<CollisionComponent*> m_children;
 
         static constexpr uint32_t MAX_DEPTH = 10;
         static constexpr uint32_t MIN_CHILDREN = 10;
@@ -129,12 +250,35 @@ public:
         void findSplitPlane(Axis& axis, float& distance);
 
     public:
+        BSPT(std::pmr::memory_resource* memory) : r_memory(memory), m_children(memory) {}
+        ~BSPT();
+
+        BSPT(const BSPT&) = delete;
+        BSPT& operator=(const BSPT&) = delete;
+
         void split(int depth = 0);
         bool isLeaf() { return !(m_left || m_right); }
-        void generateCollisionEvents(std::vector<CollisionEvent>& collisionEvents);
+
+        // adds each pair of children in a leaf whose AABBs overlap, as slots counting from first. A pair that
+        // straddles a split is in more than one leaf, so they have to be deduplicated afterwards
+        void findPairs(const CollisionComponent* first, std::pmr::vector<CollisionPair>& pairs);
+        void getLeaves(std::pmr::vector<BSPT*>& leaves);
     };
 
-    std::vector<CollisionEvent> getCollisionEvents();
+    // if set, the leaves of the BSPT, or the broadphase's pairs, are tested for collisions in parallel
+    JobSystem* r_jobSystem = nullptr;
+
+    // if set, finds the pairs to test instead of building a BSPT every step
+    Broadphase* r_broadphase = nullptr;
+
+    // filled at the start of every step
+    ColliderCache m_cache;
+
+    // points every collider at its transform and fills the cache from them, getCollisionEvents does this itself
+    void updateCache();
+
+    // everything built along the way, and the events themselves, are allocated from memory
+    std::pmr::vector<CollisionEvent> getCollisionEvents(std::pmr::memory_resource* memory = std::pmr::get_default_resource());
 };
 
 }
@@ -0,0 +1,171 @@
+#ifndef COMMANDBUFFER_HPP
+#define COMMANDBUFFER_HPP
+
+#include <component.hpp>
+#include <entity.hpp>
+
+#include <concepts>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mge::ecs {
+
+class ECSManager;
+
+/**
+ * @brief Records structural changes to the ECS so they can be applied together at a sync point
+ *
+ * Spawning and destroying entities, or adding and removing components, moves components around in their
+ * systems' storage. Recording those changes here instead lets systems keep iterating safely, and
+ * ECSManager::flush applies them all at once: spawns and component changes first, in the order they were
+ * recorded, then every destroy as one batch.
+ *
+ * Recording is thread safe. Initializers are stored inline in queues that are reused from flush to flush, so
+ * recording doesn't allocate once they've grown, but their captures must fit in MAX_CAPTURE_SIZE bytes.
+ */
+class CommandBuffer {
+public:
+    static constexpr size_t MAX_CAPTURE_SIZE = 64;
+
+private:
+    friend class ECSManager;
+
+    // like std::function, but never puts the callable on the heap
+    template<typename... Args>
+    class Callback {
+        alignas(std::max_align_t) std::byte m_storage[MAX_CAPTURE_SIZE];
+        void (*m_invoke)(std::byte*, Args...) = nullptr;
+        void (*m_move)(std::byte* from, std::byte* to) = nullptr; // destroys from, and moves it into to if it's set
+
+        void reset() {
+            if (m_move) m_move(m_storage, nullptr);
+            m_invoke = nullptr;
+            m_move = nullptr;
+        }
+
+    public:
+        Callback() = default;
+
+        template<typename Func> requires (!std::is_same_v<std::decay_t<Func>, Callback>)
+        Callback(Func&& func) {
+            typedef std::decay_t<Func> Callable;
+            static_assert(sizeof(Callable) <= MAX_CAPTURE_SIZE && alignof(Callable) <= alignof(std::max_align_t),
+                "Command buffer initializers must capture at most MAX_CAPTURE_SIZE bytes");
+
+            new (m_storage) Callable(std::forward<Func>(func));
+
+            m_invoke = [](std::byte* storage, Args... args) {
+                (*std::launder(reinterpret_cast<Callable*>(storage)))(std::forward<Args>(args)...);
+            };
+
+            m_move = [](std::byte* from, std::byte* to) {
+                auto callable = std::launder(reinterpret_cast<Callable*>(from));
+                if (to) new (to) Callable(std::move(*callable));
+                callable->~Callable();
+            };
+        }
+
+        Callback(Callback&& other) { *this = std::move(other); }
+
+        Callback& operator=(Callback&& other) {
+            if (this == &other) return *this;
+            reset();
+
+            if (other.m_move) other.m_move(other.m_storage, m_storage);
+            m_invoke = std::exchange(other.m_invoke, nullptr);
+            m_move = std::exchange(other.m_move, nullptr);
+            return *this;
+        }
+
+        ~Callback() { reset(); }
+
+        explicit operator bool() const { return m_invoke; }
+
+        void operator()(Args... args) { m_invoke(m_storage, std::forward<Args>(args)...); }
+    };
+
+    struct Spawn {
+        std::string m_templateName; // empty for a bare entity
+        Callback<ECSManager&, const Entity&> m_initializer; // empty if there isn't one
+    };
+
+    struct ComponentChange {
+        ComponentTypeID m_typeID;
+        Entity m_entity;
+        Callback<Component*> m_initializer; // empty for a removal
+    };
+
+    struct Command {
+        enum Type { e_spawn, e_componentChange } m_type;
+        size_t m_index;
+    };
+
+    std::mutex m_mutex;
+
+    std::vector<Command> m_commands;
+    std::vector<Spawn> m_spawns;
+    std::vector<ComponentChange> m_componentChanges;
+    std::vector<Entity> m_destroys;
+
+    template<typename... Initializer>
+    void recordSpawn(const std::string& templateName, Initializer&&... initializer) {
+        std::lock_guard lock { m_mutex };
+        m_commands.push_back({ Command::e_spawn, m_spawns.size() });
+        m_spawns.push_back({ templateName, { std::forward<Initializer>(initializer)... } });
+    }
+
+public:
+    // initializer is called as initializer(ecs, entity) once the entity has been made
+    template<typename Initializer> requires std::invocable<Initializer&, ECSManager&, const Entity&>
+    void spawn(Initializer&& initializer) { recordSpawn("", std::forward<Initializer>(initializer)); }
+
+    void spawn(const std::string& templateName) { recordSpawn(templateName); }
+
+    template<typename Initializer> requires std::invocable<Initializer&, ECSManager&, const Entity&>
+    void spawn(const std::string& templateName, Initializer&& initializer) {
+        recordSpawn(templateName, std::forward<Initializer>(initializer));
+    }
+
+    void destroy(const Entity& entity) {
+        std::lock_guard lock { m_mutex };
+        m_destroys.push_back(entity);
+    }
+
+    // initializer is called as initializer(component) once the component has been added
+    template<typename Component, typename Initializer>
+    void addComponent(const Entity& entity, Initializer initializer) {
+        std::lock_guard lock { m_mutex };
+        m_commands.push_back({ Command::e_componentChange, m_componentChanges.size() });
+        m_componentChanges.push_back({ getComponentTypeID<Component>(), entity,
+            [initializer = std::move(initializer)](mge::ecs::Component* component) mutable {
+                initializer(*static_cast<Component*>(component));
+            }
+        });
+    }
+
+    template<typename Component>
+    void addComponent(const Entity& entity) {
+        addComponent<Component>(entity, [](Component&) {});
+    }
+
+    template<typename Component>
+    void removeComponent(const Entity& entity) {
+        std::lock_guard lock { m_mutex };
+        m_commands.push_back({ Command::e_componentChange, m_componentChanges.size() });
+        m_componentChanges.push_back({ getComponentTypeID<Component>(), entity, {} });
+    }
+
+    bool empty() {
+        std::lock_guard lock { m_mutex };
+        return m_commands.empty() && m_destroys.empty();
+    }
+};
+
+}
+
+#endif
@@ -3,12 +3,30 @@
 
 #include <entity.hpp>
 
+#include <atomic>
+#include <cstdint>
+
 namespace mge::ecs {
 
 struct Component {
     Entity m_entity;
 };
 
+typedef uint32_t ComponentTypeID;
+
+// one bit per component type ID, set for each component an entity has
+typedef uint64_t Signature;
+constexpr ComponentTypeID MAX_COMPONENT_TYPES = 64;
+
+inline std::atomic<ComponentTypeID> s_nextComponentTypeID = 0;
+
+// a small, dense ID per component type, handed out the first time each type is asked for
+template<typename Component>
+ComponentTypeID getComponentTypeID() {
+    static const ComponentTypeID id = s_nextComponentTypeID++;
+    return id;
+}
+
 }
 
-#endif
\ No newline at end of file
+#endif
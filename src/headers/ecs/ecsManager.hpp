@@ -2,13 +2,20 @@
 #define ECSMANAGER_HPP
 
 #include <system.hpp>
+#include <view.hpp>
+#include <commandBuffer.hpp>
+#include <prefab.hpp>
+#include <archetype.hpp>
 #include <entity.hpp>
 
-#include <unordered_set>
 #include <unordered_map>
 #include <functional>
 #include <vector>
 #include <string>
+#include <span>
+#include <bit>
+#include <type_traits>
+#include <utility>
 
 #include <stdexcept>
 
@@ -17,21 +24,111 @@ namespace mge { class Engine; }
 namespace mge::ecs {
 
 class ECSManager {
-    Entity nextEntityID = 0;
+    friend class Snapshot;
+
+    // the current generation of each entity index, and the indices free to be reused
+    std::vector<uint32_t> m_generations;
+    std::vector<uint32_t> m_freeIndices;
+
+    // which components each entity index has, kept up to date by the systems themselves
+    std::vector<Signature> m_signatures;
+
+    // changed components are stamped with this, starting from 1 so that changedSince(0) matches everything.
+    // It's advanced by advanceTick and every time observers are notified, so it counts batches of changes
+    // rather than frames
+    uint32_t m_tick = 1;
+
+    // indexed by component type ID
+    std::vector<SystemBase*> m_systemsByType;
+
+    // reused between calls to destroyEntities, one batch per component type
+    std::vector<std::vector<Entity>> m_destroyBatches;
+
+    // flush() swaps these with the command buffer's queues, so both keep their capacity from frame to frame
+    std::vector<CommandBuffer::Command> m_flushCommands;
+    std::vector<CommandBuffer::Spawn> m_flushSpawns;
+    std::vector<CommandBuffer::ComponentChange> m_flushComponentChanges;
+    std::vector<Entity> m_flushDestroys;
+
+    // calls func(typeID, system) for each component type in the signature
+    template<typename Func>
+    void forEachSystem(Signature signature, Func&& func) {
+        while (signature) {
+            ComponentTypeID typeID = std::countr_zero(signature);
+            signature &= signature - 1;
+            func(typeID, m_systemsByType[typeID]);
+        }
+    }
 
 public:
     mge::Engine* r_engine;
 
-    std::unordered_set<Entity> m_entities;
+    // only used for lookups by name from debugging and tooling code
     std::unordered_map<std::string, SystemBase*> m_systems;
 
     std::unordered_map<std::string, std::function<Entity(ECSManager&)>> m_templateEntities;
 
-    Entity makeEntity() { return *m_entities.insert(nextEntityID++).first; }
+    // structural changes made while systems are running, applied by flush()
+    CommandBuffer m_commandBuffer;
+
+    // optional storage for components that aren't owned by a system, grouped by archetype
+    ArchetypeStorage m_archetypes;
+
+    Entity makeEntity() {
+        if (!m_freeIndices.empty()) {
+            uint32_t index = m_freeIndices.back();
+            m_freeIndices.pop_back();
+            return Entity { index, m_generations[index] };
+        }
+
+        m_generations.push_back(0);
+        m_signatures.push_back(0);
+        return Entity { static_cast<uint32_t>(m_generations.size() - 1), 0 };
+    }
+
+    bool isAlive(const Entity& entity) const {
+        return entity.m_index < m_generations.size() && m_generations[entity.m_index] == entity.m_generation;
+    }
+
+    size_t getEntityCount() const { return m_generations.size() - m_freeIndices.size(); }
 
-    void addSystem(const std::string& name, SystemBase* system) {
+    uint32_t getTick() const { return m_tick; }
+
+    // call once per frame, before any systems run, so each frame's changes get a tick of their own
+    void advanceTick() { m_tick++; }
+
+    Signature getSignature(const Entity& entity) const {
+        return isAlive(entity) ? m_signatures[entity.m_index] : 0;
+    }
+
+    template<typename Component>
+    void addSystem(const std::string& name, System<Component>* system) {
         system->r_ecsManager = this;
         m_systems[name] = system;
+
+        ComponentTypeID typeID = getComponentTypeID<Component>();
+        if (typeID >= MAX_COMPONENT_TYPES)
+            throw std::runtime_error("System '" + name + "' has a component type ID too large to fit in a signature");
+
+        if (typeID >= m_systemsByType.size()) m_systemsByType.resize(typeID + 1, nullptr);
+        m_systemsByType[typeID] = system;
+
+        system->r_signatures = &m_signatures;
+        system->m_typeID = typeID;
+        system->r_tick = &m_tick;
+
+        // the system may already have components from before it was added
+        for (const auto& entity : system->m_components.entities())
+        if (isAlive(entity))
+            m_signatures[entity.m_index] |= Signature { 1 } << typeID;
+    }
+
+    // returns nullptr if no system for this component type has been added
+    template<typename Component>
+    System<Component>* getSystem() {
+        ComponentTypeID typeID = getComponentTypeID<Component>();
+        if (typeID >= m_systemsByType.size()) return nullptr;
+        return static_cast<System<Component>*>(m_systemsByType[typeID]);
     }
 
     template<typename Component>
@@ -39,10 +136,144 @@ public:
         return static_cast<System<Component>*>(m_systems.at(name));
     }
 
+    // components viewed as const aren't marked as changed
+    template<typename... Components>
+    View<Components...> view() {
+        return View<Components...>(m_tick, getSystem<std::remove_const_t<Components>>()...);
+    }
+
+    // only visits the systems the entity has components in
     void destroyEntity(const Entity& entity) {
-        for (auto& [ _, system ] : m_systems)
+        if (!isAlive(entity)) return;
+
+        forEachSystem(m_signatures[entity.m_index], [&](ComponentTypeID, SystemBase* system) {
             system->removeComponent(entity);
-        m_entities.erase(entity);
+        });
+
+        m_archetypes.destroy(entity);
+        m_signatures[entity.m_index] = 0;
+        m_generations[entity.m_index]++;
+        m_freeIndices.push_back(entity.m_index);
+    }
+
+    // groups the entities by component type, so each system removes its share in one batch,
+    // skipping stale and repeated handles
+    void destroyEntities(std::span<const Entity> entities) {
+        m_destroyBatches.resize(m_systemsByType.size());
+
+        for (const auto& entity : entities)
+        if (isAlive(entity)) {
+            forEachSystem(m_signatures[entity.m_index], [&](ComponentTypeID typeID, SystemBase*) {
+                m_destroyBatches[typeID].push_back(entity);
+            });
+
+            m_archetypes.destroy(entity);
+
+            // bumping the generation now means repeats of this handle fail isAlive
+            m_signatures[entity.m_index] = 0;
+            m_generations[entity.m_index]++;
+            m_freeIndices.push_back(entity.m_index);
+        }
+
+        for (ComponentTypeID typeID = 0; typeID < m_destroyBatches.size(); typeID++) {
+            auto& batch = m_destroyBatches[typeID];
+            if (batch.empty()) continue;
+
+            m_systemsByType[typeID]->removeComponents(batch);
+            batch.clear();
+        }
+    }
+
+    // applies everything recorded in m_commandBuffer
+    void flush() {
+        // taken rather than used in place, so a flush from inside an initializer just starts with empty queues
+        std::vector<CommandBuffer::Command> commands = std::move(m_flushCommands);
+        std::vector<CommandBuffer::Spawn> spawns = std::move(m_flushSpawns);
+        std::vector<CommandBuffer::ComponentChange> componentChanges = std::move(m_flushComponentChanges);
+        std::vector<Entity> destroys = std::move(m_flushDestroys);
+
+        // take the commands out first, so anything recorded while applying them waits for the next flush
+        {
+            std::lock_guard lock { m_commandBuffer.m_mutex };
+            std::swap(commands, m_commandBuffer.m_commands);
+            std::swap(spawns, m_commandBuffer.m_spawns);
+            std::swap(componentChanges, m_commandBuffer.m_componentChanges);
+            std::swap(destroys, m_commandBuffer.m_destroys);
+        }
+
+        for (const auto& command : commands) {
+            if (command.m_type == CommandBuffer::Command::e_spawn) {
+                auto& spawn = spawns[command.m_index];
+                Entity entity = spawn.m_templateName.empty() ? makeEntity() : makeEntityFromTemplate(spawn.m_templateName);
+                if (spawn.m_initializer) spawn.m_initializer(*this, entity);
+                continue;
+            }
+
+            auto& change = componentChanges[command.m_index];
+            if (!isAlive(change.m_entity) || change.m_typeID >= m_systemsByType.size()) continue;
+
+            auto system = m_systemsByType[change.m_typeID];
+            if (!system) continue;
+
+            if (change.m_initializer) change.m_initializer(system->addAnonymousComponent(change.m_entity));
+            else system->removeComponent(change.m_entity);
+        }
+
+        destroyEntities(destroys);
+
+        commands.clear();
+        spawns.clear();
+        componentChanges.clear();
+        destroys.clear();
+
+        m_flushCommands = std::move(commands);
+        m_flushSpawns = std::move(spawns);
+        m_flushComponentChanges = std::move(componentChanges);
+        m_flushDestroys = std::move(destroys);
+
+        notifyObservers();
+    }
+
+    /**
+     * @brief Delivers every system's batched construct, update and destroy signals, flush() ends with this
+     *
+     * The change tick is advanced first, so changes made up to now are in this batch and anything the
+     * observers change themselves is stamped newer and goes into the next one.
+     */
+    void notifyObservers() {
+        m_tick++;
+
+        for (auto system : m_systemsByType)
+            if (system) system->notifyObservers();
+    }
+
+    /**
+     * @brief Makes count entities from the prefab, then calls initializer(ecs, entity, index) on each of them
+     *
+     * Every component type in the prefab is added to the whole batch before moving on to the next type.
+     */
+    template<typename Func>
+    std::vector<Entity> spawnBatch(const Prefab& prefab, size_t count, Func&& initializer) {
+        m_generations.reserve(m_generations.size() + count);
+        m_signatures.reserve(m_signatures.size() + count);
+
+        std::vector<Entity> entities(count);
+        for (auto& entity : entities) entity = makeEntity();
+
+        for (const auto& entry : prefab.m_entries) {
+            if (entry.m_typeID >= m_systemsByType.size() || !m_systemsByType[entry.m_typeID])
+                throw std::runtime_error("Prefab has a component type with no system added for it");
+
+            entry.m_instantiate(*m_systemsByType[entry.m_typeID], entities);
+        }
+
+        for (size_t i = 0; i < count; i++) initializer(*this, entities[i], i);
+
+        return entities;
+    }
+
+    std::vector<Entity> spawnBatch(const Prefab& prefab, size_t count) {
+        return spawnBatch(prefab, count, [](ECSManager&, const Entity&, size_t) {});
     }
 
     void addTemplate(const std::string& name, std::function<Entity(ECSManager&)> func) {
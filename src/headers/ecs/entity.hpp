@@ -1,10 +1,31 @@
 #ifndef ENTITY_HPP
 #define ENTITY_HPP
 
+#include <cstdint>
+#include <functional>
+
 namespace mge::ecs {
 
-typedef unsigned long long Entity;
+/**
+ * @brief A handle to an entity
+ *
+ * The index is recycled once an entity is destroyed, the generation is bumped each time that happens so stale
+ * handles to the old entity can be told apart from the new one.
+ */
+struct Entity {
+    uint32_t m_index = 0;
+    uint32_t m_generation = 0;
+
+    bool operator==(const Entity& other) const = default;
+};
 
 }
 
-#endif
\ No newline at end of file
+template<>
+struct std::hash<mge::ecs::Entity> {
+    size_t operator()(const mge::ecs::Entity& entity) const {
+        return std::hash<uint64_t>{}(static_cast<uint64_t>(entity.m_generation) << 32 | entity.m_index);
+    }
+};
+
+#endif
@@ -19,22 +19,41 @@ public:
 
 class LightSystem : public System<LightComponent> {
     int m_nextShadowMapID = 0;
+    uint32_t m_lastUpdateTick = 0;
 
 public:
     mge::Light* r_shadowlessLight;
     mge::ShadowMappedLight* r_shadowMappedLightPrototype;
     std::unordered_map<int, std::unique_ptr<mge::ShadowMappedLight>> m_shadowMappedLights;
 
+    LightSystem() {
+        onDestroy([this](std::span<const LightComponent> removed) {
+            for (const auto& comp : removed)
+                getLight(comp)->destroyInstance(comp.m_instanceID);
+        });
+    }
+
     LightComponent* addComponent(const Entity& entity) override {
-        r_ecsManager->getSystem<TransformComponent>("Transform")->addComponent(entity);
+        r_ecsManager->getSystem<TransformComponent>()->addComponent(entity);
 
         auto* comp = System<LightComponent>::addComponent(entity);
         comp->m_instanceID = r_shadowlessLight->makeInstance();
         return comp;
     }
 
+    // prefabs can only make shadowless lights, each entity gets its own instance of it
+    void addComponents(std::span<const Entity> entities, const LightComponent& blueprint) override {
+        System<LightComponent>::addComponents(entities, blueprint);
+
+        for (const auto& entity : entities) {
+            auto* comp = getComponent(entity);
+            comp->m_shadowMapID.reset();
+            comp->m_instanceID = r_shadowlessLight->makeInstance();
+        }
+    }
+
     LightComponent* addComponentShadowMapped(const Entity& entity, uint32_t shadowMapResolution) {
-        r_ecsManager->getSystem<TransformComponent>("Transform")->addComponent(entity);
+        r_ecsManager->getSystem<TransformComponent>()->addComponent(entity);
 
         auto* comp = System<LightComponent>::addComponent(entity);
 
@@ -72,27 +91,24 @@ public:
         } else return r_shadowlessLight;
     }
 
-    void update() {
-        auto transformSystem = r_ecsManager->getSystem<TransformComponent>("Transform");
+    // m_instanceID is the renderer's, and is freed when the component is removed, so it can't be saved
+    bool isSnapshottable() const override { return false; }
 
-        for (auto& [ entity, comp ] : m_components)
-        if (const auto transform = transformSystem->getComponent(entity)) {
+    // only rewrites the instances of lights that have changed or moved since the last update
+    void update() {
+        auto changed = r_ecsManager->view<const LightComponent, const TransformComponent>().changedSince(m_lastUpdateTick);
+        for (auto [ entity, comp, transform ] : changed) {
             auto instance = getInstance(comp);
-            instance->m_position = transform->getPosition();
-            instance->m_direction = transform->getForward();
+            instance->m_position = transform.getWorldPosition();
+            instance->m_direction = transform.getForward();
         }
 
+        m_lastUpdateTick = r_ecsManager->getTick();
+
         r_shadowlessLight->updateInstanceBuffer();
 
         for (auto& [ _, light ] : m_shadowMappedLights) light->updateInstanceBuffer();
     }
-
-    void removeComponent(const Entity& entity) override {
-        if (auto comp = getComponent(entity))
-            r_shadowlessLight->destroyInstance(comp->m_instanceID);
-        
-        System<LightComponent>::removeComponent(entity);
-    }
 };
 
 }
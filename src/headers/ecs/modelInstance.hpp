@@ -3,6 +3,7 @@
 
 #include <component.hpp>
 #include <system.hpp>
+#include <ecsManager.hpp>
 #include <transform.hpp>
 #include <model.hpp>
 #include <instance.hpp>
@@ -16,15 +17,32 @@ public:
 };
 
 class ModelSystem : public System<ModelComponent> {
+    uint32_t m_lastUpdateTick = 0;
+
+    // entities whose instance moved in the last update, so their previous transform still needs catching up
+    std::vector<Entity> m_movedLastUpdate;
+
+    ModelTransformMeshInstance* getTransformInstance(const ModelComponent& comp) {
+        return static_cast<ModelTransformMeshInstance*>(&r_models.at(comp.m_modelName)->getInstance(comp.m_instanceID));
+    }
+
 public:
     std::unordered_map<std::string, ModelBase*> r_models;
 
+    ModelSystem() {
+        // removed instances are destroyed at the next sync point, which comes before buffers are next updated
+        onDestroy([this](std::span<const ModelComponent> removed) {
+            for (const auto& comp : removed)
+                r_models.at(comp.m_modelName)->destroyInstance(comp.m_instanceID);
+        });
+    }
+
     void addModel(std::string name, ModelBase* model) {
         r_models[name] = model;
     }
 
     ModelComponent* addComponent(const Entity& entity, const std::string modelName) {
-        r_ecsManager->getSystem<TransformComponent>("Transform")->addComponent(entity);
+        r_ecsManager->getSystem<TransformComponent>()->addComponent(entity);
 
         auto* comp = System<ModelComponent>::addComponent(entity);
         comp->m_modelName = modelName;
@@ -32,26 +50,46 @@ public:
         return comp;
     }
 
+    // makes a model instance for each entity, from the blueprint's model name
+    void addComponents(std::span<const Entity> entities, const ModelComponent& blueprint) override {
+        auto model = r_models.at(blueprint.m_modelName);
+        System<ModelComponent>::addComponents(entities, blueprint);
+
+        for (const auto& entity : entities)
+            getComponent(entity)->m_instanceID = model->makeInstance();
+    }
+
+    // only touches the instances of entities whose model or transform has changed since the last update, call it
+    // after TransformSystem::swapBuffers so previous transforms come from its double buffer
     void updateTransforms() {
-        auto transformSystem = r_ecsManager->getSystem<TransformComponent>("Transform");
+        auto transformSystem = r_ecsManager->getSystem<TransformComponent>();
+        auto buffered = dynamic_cast<TransformSystem*>(transformSystem);
+
+        auto previousOf = [&](const Entity& entity, const TransformComponent& transform) {
+            return buffered ? buffered->getPreviousMatrix(entity) : transform.getMat4();
+        };
+
+        // these stopped moving, so their previous transform catches up with the current one
+        for (const auto& entity : m_movedLastUpdate)
+        if (auto comp = readComponent(entity))
+        if (auto transform = transformSystem->readComponent(entity))
+            getTransformInstance(*comp)->m_previousModelTransform = previousOf(entity, *transform);
+
+        m_movedLastUpdate.clear();
 
-        for (auto& [ entity, comp ] : m_components)
-        if (const auto transform = transformSystem->getComponent(entity)) {
-            auto instance = static_cast<ModelTransformMeshInstance*>(&r_models.at(comp.m_modelName)->getInstance(comp.m_instanceID));
-            instance->m_previousModelTransform = instance->m_modelTransform;
-            instance->m_modelTransform = transform->getMat4();
+        auto changed = r_ecsManager->view<const ModelComponent, const TransformComponent>().changedSince(m_lastUpdateTick);
+        for (auto [ entity, comp, transform ] : changed) {
+            auto instance = getTransformInstance(comp);
+            instance->m_previousModelTransform = previousOf(entity, transform);
+            instance->m_modelTransform = transform.getMat4();
+            m_movedLastUpdate.push_back(entity);
         }
 
+        m_lastUpdateTick = r_ecsManager->getTick();
+
         for (auto [ _, model ] : r_models)
             model->updateInstanceBuffer();
     }
-
-    void removeComponent(const Entity& entity) override {
-        if (auto comp = getComponent(entity))
-            r_models.at(comp->m_modelName)->destroyInstance(comp->m_instanceID);
-        
-        System<ModelComponent>::removeComponent(entity);
-    }
 };
 
 }
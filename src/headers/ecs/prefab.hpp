@@ -0,0 +1,66 @@
+#ifndef PREFAB_HPP
+#define PREFAB_HPP
+
+#include <component.hpp>
+#include <system.hpp>
+#include <entity.hpp>
+
+#include <functional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace mge::ecs {
+
+/**
+ * @brief A blueprint of components to stamp onto many entities at once
+ *
+ * Each component is captured once when it's added to the prefab. ECSManager::spawnBatch then gives every
+ * new entity a copy of it, one component type at a time with the system's storage reserved up front, and
+ * only after that calls the initializer on each entity to fill in whatever differs between them:
+ *
+ *     Prefab asteroid;
+ *     asteroid.add<TransformComponent>().add(rigidbodyBlueprint).add<CollisionComponent>();
+ *     ecs.spawnBatch(asteroid, 4'000, [&](ECSManager& ecs, const Entity& entity, size_t index) { ... });
+ */
+class Prefab {
+    friend class ECSManager;
+
+    struct Entry {
+        ComponentTypeID m_typeID;
+        std::function<void(SystemBase&, std::span<const Entity>)> m_instantiate;
+    };
+
+    std::vector<Entry> m_entries;
+
+public:
+    // every entity gets a copy of blueprint
+    template<typename Component>
+    Prefab& add(const Component& blueprint) {
+        static_assert(std::is_copy_assignable_v<Component>, "components that can't be copied have to be added with add<Component>()");
+
+        m_entries.push_back({ getComponentTypeID<Component>(),
+            [blueprint](SystemBase& system, std::span<const Entity> entities) {
+                static_cast<System<Component>&>(system).addComponents(entities, blueprint);
+            }
+        });
+
+        return *this;
+    }
+
+    // every entity gets a default component, for components that can't be copied
+    template<typename Component>
+    Prefab& add() {
+        m_entries.push_back({ getComponentTypeID<Component>(),
+            [](SystemBase& system, std::span<const Entity> entities) {
+                static_cast<System<Component>&>(system).addComponents(entities);
+            }
+        });
+
+        return *this;
+    }
+};
+
+}
+
+#endif
@@ -26,25 +26,22 @@ public:
 class RigidbodySystem : public System<RigidbodyComponent> {
 public:
     void update(float deltaTime) {
-        auto transformSystem = r_ecsManager->getSystem<TransformComponent>("Transform");
-
-        for (auto& [ entity, rigidbody ] : m_components)
-        if (auto transform = transformSystem->getComponent(entity)) {
+        for (auto [ entity, rigidbody, transform ] : r_ecsManager->view<RigidbodyComponent, TransformComponent>()) {
             rigidbody.m_velocity += rigidbody.m_acceleration * deltaTime;
 
-            transform->setPosition(transform->getPosition() + rigidbody.m_velocity * deltaTime);
+            transform.setPosition(transform.getPosition() + rigidbody.m_velocity * deltaTime);
 
             glm::vec3 angularVelocity = rigidbody.m_angularVelocity * deltaTime;
 
             if (angularVelocity != glm::vec3 { 0.f }) {
                 glm::quat deltaRotation = glm::angleAxis(glm::length(angularVelocity), glm::normalize(angularVelocity));
-                transform->setRotation(deltaRotation * transform->getRotation());
+                transform.setRotation(deltaRotation * transform.getRotation());
             }
         }
     }
 
-    void resolveCollisions(std::vector<CollisionEvent> collisionEvents) {
-        auto transformSystem = r_ecsManager->getSystem<TransformComponent>("Transform");
+    void resolveCollisions(std::span<const CollisionEvent> collisionEvents) {
+        auto transformSystem = r_ecsManager->getSystem<TransformComponent>();
 
         for (const auto& collisionEvent : collisionEvents)
         if (auto thisRigidBody = getComponent(collisionEvent.m_thisEntity))
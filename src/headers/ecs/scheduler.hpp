@@ -0,0 +1,152 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <component.hpp>
+#include <jobSystem.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mge::ecs {
+
+/**
+ * @brief Runs ECS systems concurrently, ordered by the component types they read and write
+ *
+ * Each task declares the component types it reads and writes. Two tasks conflict if either writes something
+ * the other reads or writes, and conflicting tasks always run in the order they were added. Everything else
+ * is free to run at the same time on the job system's workers.
+ *
+ *     scheduler.addTask("Integrate", [&]{ rigidbodySystem.update(deltaTime); })
+ *         .writes<RigidbodyComponent, TransformComponent>();
+ *
+ * Tasks shouldn't make structural changes to the ECS directly, they should record them in the ECSManager's
+ * command buffer and let it be flushed once the scheduler has finished.
+ */
+class Scheduler {
+public:
+    class Task {
+        friend class Scheduler;
+
+        std::string m_name;
+        std::function<void()> m_func;
+        std::vector<ComponentTypeID> m_reads, m_writes;
+        double m_lastMillis = 0.0;
+
+        bool conflictsWith(const Task& other) const {
+            auto overlaps = [](const std::vector<ComponentTypeID>& a, const std::vector<ComponentTypeID>& b) {
+                for (auto type : a)
+                    if (std::find(b.begin(), b.end(), type) != b.end()) return true;
+                return false;
+            };
+
+            return overlaps(m_writes, other.m_writes)
+                || overlaps(m_writes, other.m_reads)
+                || overlaps(m_reads, other.m_writes);
+        }
+
+    public:
+        Task(const std::string& name, std::function<void()> func) : m_name(name), m_func(std::move(func)) {}
+
+        template<typename... Components>
+        Task& reads() {
+            (m_reads.push_back(getComponentTypeID<Components>()), ...);
+            return *this;
+        }
+
+        template<typename... Components>
+        Task& writes() {
+            (m_writes.push_back(getComponentTypeID<Components>()), ...);
+            return *this;
+        }
+
+        const std::string& getName() const { return m_name; }
+
+        // how long the task took the last time the scheduler ran
+        double getLastMillis() const { return m_lastMillis; }
+    };
+
+private:
+    std::vector<Task> m_tasks;
+    std::vector<std::vector<size_t>> m_dependents;
+    std::vector<uint32_t> m_dependencyCounts;
+    double m_lastMillis = 0.0;
+
+    void buildGraph() {
+        m_dependents.assign(m_tasks.size(), {});
+        m_dependencyCounts.assign(m_tasks.size(), 0);
+
+        for (size_t later = 0; later < m_tasks.size(); later++)
+        for (size_t earlier = 0; earlier < later; earlier++)
+        if (m_tasks[earlier].conflictsWith(m_tasks[later])) {
+            m_dependents[earlier].push_back(later);
+            m_dependencyCounts[later]++;
+        }
+    }
+
+public:
+    // the returned task is only valid until the next call to addTask
+    Task& addTask(const std::string& name, std::function<void()> func) {
+        return m_tasks.emplace_back(name, std::move(func));
+    }
+
+    const std::vector<Task>& getTasks() const { return m_tasks; }
+
+    // how long the last run took from start to finish
+    double getLastMillis() const { return m_lastMillis; }
+
+    void clear() { m_tasks.clear(); }
+
+    // runs every task once, returning when they have all finished
+    void run(JobSystem& jobs) {
+        auto runStart = std::chrono::high_resolution_clock::now();
+
+        buildGraph();
+
+        size_t taskCount = m_tasks.size();
+        auto remaining = std::make_unique<std::atomic<uint32_t>[]>(taskCount);
+        for (size_t i = 0; i < taskCount; i++) remaining[i] = m_dependencyCounts[i];
+
+        TaskGroup group;
+
+        std::function<void(size_t)> execute = [&](size_t index) {
+            Task& task = m_tasks[index];
+            auto start = std::chrono::high_resolution_clock::now();
+
+            task.m_func();
+
+            auto elapsed = std::chrono::high_resolution_clock::now() - start;
+            task.m_lastMillis = std::chrono::duration<double, std::milli>(elapsed).count();
+
+            for (size_t dependent : m_dependents[index])
+                if (--remaining[dependent] == 0)
+                    jobs.submit(group, [&, dependent]{ execute(dependent); });
+        };
+
+        for (size_t i = 0; i < taskCount; i++)
+            if (m_dependencyCounts[i] == 0)
+                jobs.submit(group, [&, i]{ execute(i); });
+
+        jobs.wait(group);
+
+        auto elapsed = std::chrono::high_resolution_clock::now() - runStart;
+        m_lastMillis = std::chrono::duration<double, std::milli>(elapsed).count();
+    }
+
+    void printTimings(std::ostream& out) const {
+        out << std::fixed << std::setprecision(3);
+        for (const auto& task : m_tasks)
+            out << std::setw(24) << task.m_name << std::setw(10) << task.m_lastMillis << " ms" << std::endl;
+        out << std::setw(24) << "total" << std::setw(10) << m_lastMillis << " ms" << std::endl;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <ecsManager.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace mge::ecs {
+
+/**
+ * @brief Saves an ECSManager's entities and components to a binary file, and loads them back
+ *
+ * The file is a Header, the entity table (each index's generation, then the free list) and one blob per
+ * system: a BlobHeader, the system's name, its entities and then its components as raw bytes. Everything is
+ * in native byte order and every section starts on a 16 byte boundary. Loading maps the file into memory and
+ * copies each blob straight into the system's storage.
+ *
+ * Blobs are matched to systems by the name they were added to the ECSManager with, and are rejected if the
+ * component size doesn't match. Only snapshottable systems are saved, ones whose components are trivially
+ * copyable and don't refer to anything outside the ECS. Loading drops every component of every other system
+ * (models, lights, colliders), so they have to be added back afterwards, e.g. with a prefab.
+ *
+ *     Snapshot::save(ecs, "level.mges");
+ *     Snapshot::load(ecs, "level.mges");
+ */
+class Snapshot {
+public:
+    // bump whenever the layout changes, older files are rejected rather than misread
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header {
+        char m_magic[4];
+        uint32_t m_version;
+        uint32_t m_entityCount;
+        uint32_t m_freeCount;
+        uint32_t m_blobCount;
+        uint32_t m_padding[3];
+    };
+
+    struct BlobHeader {
+        uint32_t m_nameLength;
+        uint32_t m_componentSize;
+        uint32_t m_count;
+        uint32_t m_padding;
+    };
+
+    // throws std::runtime_error if the file can't be written
+    static void save(const ECSManager& ecs, const std::string& path);
+
+    // throws std::runtime_error if the file can't be read or doesn't match this world's systems
+    static void load(ECSManager& ecs, const std::string& path);
+};
+
+}
+
+#endif
@@ -0,0 +1,189 @@
+#ifndef SPARSESET_HPP
+#define SPARSESET_HPP
+
+#include <entity.hpp>
+
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+namespace mge::ecs {
+
+/**
+ * @brief Packed component storage keyed by entity
+ *
+ * Components and their owning entities live in two parallel, contiguous arrays. A sparse array indexed by
+ * entity index maps an entity to its slot in those arrays, so add, get and remove are all O(1) array reads and
+ * removal swaps the last element into the hole left behind. Lookups compare the full handle, so a stale handle
+ * whose index has since been recycled finds nothing.
+ *
+ * Adding or removing a component may move other components, so pointers and references returned by this
+ * container are only valid until the next add or remove.
+ *
+ * Each component also carries a version, the change tick it was last changed at. The set only stores it, it's up to
+ * the owner to say when a component has changed.
+ */
+template<typename Component>
+class SparseSet {
+public:
+    static constexpr uint32_t INVALID_INDEX = ~0u;
+
+private:
+    std::vector<uint32_t> m_sparse;
+    std::vector<Entity> m_entities;
+    std::vector<Component> m_dense;
+    std::vector<uint32_t> m_versions;
+
+    uint32_t getIndex(const Entity& entity) const {
+        if (entity.m_index >= m_sparse.size()) return INVALID_INDEX;
+
+        uint32_t index = m_sparse[entity.m_index];
+        if (index == INVALID_INDEX || m_entities[index] != entity) return INVALID_INDEX;
+        return index;
+    }
+
+    void setIndex(const Entity& entity, uint32_t index) {
+        if (entity.m_index >= m_sparse.size()) m_sparse.resize(entity.m_index + 1, INVALID_INDEX);
+        m_sparse[entity.m_index] = index;
+    }
+
+    void eraseAt(uint32_t index) {
+        Entity entity = m_entities[index];
+        uint32_t last = static_cast<uint32_t>(m_dense.size() - 1);
+
+        if (index != last) {
+            m_dense[index] = std::move(m_dense[last]);
+            m_entities[index] = m_entities[last];
+            m_versions[index] = m_versions[last];
+            setIndex(m_entities[index], index);
+        }
+
+        m_dense.pop_back();
+        m_entities.pop_back();
+        m_versions.pop_back();
+        setIndex(entity, INVALID_INDEX);
+    }
+
+public:
+    typedef typename std::vector<Component>::iterator iterator;
+    typedef typename std::vector<Component>::const_iterator const_iterator;
+
+    bool contains(const Entity& entity) const { return getIndex(entity) != INVALID_INDEX; }
+
+    // the entity's slot in the packed arrays, or INVALID_INDEX
+    uint32_t indexOf(const Entity& entity) const { return getIndex(entity); }
+
+    // exchanges two slots in the packed arrays, handles still find their own components afterwards
+    void swapSlots(uint32_t a, uint32_t b) {
+        if (a == b) return;
+
+        std::swap(m_dense[a], m_dense[b]);
+        std::swap(m_entities[a], m_entities[b]);
+        std::swap(m_versions[a], m_versions[b]);
+        setIndex(m_entities[a], a);
+        setIndex(m_entities[b], b);
+    }
+
+    Component* get(const Entity& entity) {
+        uint32_t index = getIndex(entity);
+        if (index == INVALID_INDEX) return nullptr;
+        return &m_dense[index];
+    }
+
+    const Component* get(const Entity& entity) const {
+        uint32_t index = getIndex(entity);
+        if (index == INVALID_INDEX) return nullptr;
+        return &m_dense[index];
+    }
+
+    // returns the component and sets its version, or nullptr if the entity doesn't have one
+    Component* touch(const Entity& entity, uint32_t version) {
+        uint32_t index = getIndex(entity);
+        if (index == INVALID_INDEX) return nullptr;
+
+        m_versions[index] = version;
+        return &m_dense[index];
+    }
+
+    // returns 0 if the entity doesn't have a component
+    uint32_t getVersion(const Entity& entity) const {
+        uint32_t index = getIndex(entity);
+        return index == INVALID_INDEX ? 0 : m_versions[index];
+    }
+
+    // returns the existing component if the entity already has one, either way its version is set
+    Component& emplace(const Entity& entity, uint32_t version = 0) {
+        if (auto existing = touch(entity, version)) return *existing;
+
+        // a component left behind by an older entity with the same index
+        if (entity.m_index < m_sparse.size() && m_sparse[entity.m_index] != INVALID_INDEX)
+            eraseAt(m_sparse[entity.m_index]);
+
+        setIndex(entity, static_cast<uint32_t>(m_dense.size()));
+        m_entities.push_back(entity);
+        m_versions.push_back(version);
+        return m_dense.emplace_back();
+    }
+
+    // returns whether the entity had a component to erase
+    bool erase(const Entity& entity) {
+        uint32_t index = getIndex(entity);
+        if (index == INVALID_INDEX) return false;
+
+        eraseAt(index);
+        return true;
+    }
+
+    void reserve(size_t count) {
+        m_dense.reserve(count);
+        m_entities.reserve(count);
+        m_versions.reserve(count);
+    }
+
+    void clear() {
+        m_sparse.clear();
+        m_entities.clear();
+        m_dense.clear();
+        m_versions.clear();
+    }
+
+    // replaces the contents with a copy of raw component memory, e.g. straight out of a snapshot file
+    void assign(std::span<const Entity> entities, const void* components, uint32_t version) {
+        static_assert(std::is_trivially_copyable_v<Component>, "only trivially copyable components can be copied as bytes");
+
+        clear();
+
+        m_entities.assign(entities.begin(), entities.end());
+        m_dense.resize(entities.size());
+        if (!entities.empty()) std::memcpy(m_dense.data(), components, entities.size() * sizeof(Component));
+        m_versions.assign(entities.size(), version);
+
+        for (uint32_t i = 0; i < m_entities.size(); i++) setIndex(m_entities[i], i);
+    }
+
+    size_t size() const { return m_dense.size(); }
+    bool empty() const { return m_dense.empty(); }
+
+    Component* data() { return m_dense.data(); }
+    const Component* data() const { return m_dense.data(); }
+    const std::vector<Entity>& entities() const { return m_entities; }
+
+    // parallel to data()
+    uint32_t* versions() { return m_versions.data(); }
+    const uint32_t* versions() const { return m_versions.data(); }
+
+    Component& operator[](size_t index) { return m_dense[index]; }
+    const Component& operator[](size_t index) const { return m_dense[index]; }
+
+    iterator begin() { return m_dense.begin(); }
+    iterator end() { return m_dense.end(); }
+    const_iterator begin() const { return m_dense.begin(); }
+    const_iterator end() const { return m_dense.end(); }
+};
+
+}
+
+#endif
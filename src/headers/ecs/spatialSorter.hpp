@@ -0,0 +1,193 @@
+#ifndef SPATIALSORTER_HPP
+#define SPATIALSORTER_HPP
+
+#include <entity.hpp>
+#include <system.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace mge::ecs {
+
+/**
+ * @brief Keeps the packed component arrays of chosen systems in Morton order of their entities' positions
+ *
+ * Entities that are close together in the world end up close together in memory, so passes that visit
+ * spatial neighbours (the collision broadphase, rigidbody resolution) stay in cache instead of jumping around
+ * the arrays in spawn order. Components are only ever swapped between slots, so entity handles stay valid,
+ * but pointers to components don't, so step() belongs at a sync point next to ECSManager::flush().
+ *
+ * A pass works out the target order of every system up front and then moves at most a fixed number of
+ * components per step(), so it can be spread over several frames:
+ *
+ *     SpatialSorter sorter([&](const Entity& entity, float (&position)[3]) { ... });
+ *     sorter.addSystem(&transformSystem).addSystem(&collisionSystem);
+ *     sorter.step(1024);
+ *
+ * Entities added during a pass stay at the end of the arrays until the next one, entities removed during it
+ * are skipped.
+ */
+class SpatialSorter {
+public:
+    // writes the entity's position and returns true, or returns false if it doesn't have one
+    typedef std::function<bool(const Entity&, float (&)[3])> PositionGetter;
+
+    static constexpr uint32_t BITS_PER_AXIS = 21;
+    static constexpr uint32_t MAX_CELL = (1u << BITS_PER_AXIS) - 1;
+
+private:
+    struct Target {
+        SystemBase* r_system;
+        std::vector<std::pair<Entity, std::array<float, 3>>> m_positions;
+        std::vector<Entity> m_order;
+        size_t m_next = 0;
+        uint32_t m_slot = 0;
+
+        Target(SystemBase* system) : r_system(system) {}
+    };
+
+    PositionGetter m_getPosition;
+    std::vector<Target> m_targets;
+    size_t m_currentTarget = 0;
+    size_t m_completedPasses = 0;
+    bool m_passInProgress = false;
+
+    // reused by beginPass
+    std::vector<std::pair<uint64_t, Entity>> m_keyed;
+
+    // spreads the low 21 bits of value out so there are two zero bits between each of them
+    static uint64_t spreadBits(uint64_t value) {
+        value &= 0x1fffff;
+        value = (value | value << 32) & 0x1f00000000ffff;
+        value = (value | value << 16) & 0x1f0000ff0000ff;
+        value = (value | value << 8)  & 0x100f00f00f00f00f;
+        value = (value | value << 4)  & 0x10c30c30c30c30c3;
+        value = (value | value << 2)  & 0x1249249249249249;
+        return value;
+    }
+
+    void beginPass() {
+        constexpr float inf = std::numeric_limits<float>::infinity();
+        float min[3] = { inf, inf, inf }, max[3] = { -inf, -inf, -inf };
+
+        // quantise against the bounds of everything being sorted, so each pass uses the full key range
+        for (Target& target : m_targets) {
+            target.m_positions.clear();
+
+            for (const Entity& entity : target.r_system->getEntities()) {
+                float position[3];
+                if (!m_getPosition(entity, position)) continue;
+
+                target.m_positions.push_back({ entity, { position[0], position[1], position[2] } });
+
+                for (int axis = 0; axis < 3; axis++) {
+                    min[axis] = std::min(min[axis], position[axis]);
+                    max[axis] = std::max(max[axis], position[axis]);
+                }
+            }
+        }
+
+        float scale[3];
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = max[axis] - min[axis];
+            scale[axis] = extent > 0.f ? float(MAX_CELL) / extent : 0.f;
+        }
+
+        for (Target& target : m_targets) {
+            m_keyed.clear();
+
+            for (auto& [entity, position] : target.m_positions) {
+                uint32_t cell[3];
+                for (int axis = 0; axis < 3; axis++)
+                    cell[axis] = std::min(uint32_t((position[axis] - min[axis]) * scale[axis]), MAX_CELL);
+
+                m_keyed.push_back({ mortonCode(cell[0], cell[1], cell[2]), entity });
+            }
+
+            std::sort(m_keyed.begin(), m_keyed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+            // entities without a position aren't in the order, so they're left behind the sorted ones
+            target.m_order.clear();
+            for (auto& [key, entity] : m_keyed) target.m_order.push_back(entity);
+            target.m_next = 0;
+            target.m_slot = 0;
+        }
+
+        m_currentTarget = 0;
+        m_passInProgress = true;
+    }
+
+public:
+    SpatialSorter(PositionGetter getPosition) : m_getPosition(std::move(getPosition)) {}
+
+    static uint64_t mortonCode(uint32_t x, uint32_t y, uint32_t z) {
+        return spreadBits(x) | spreadBits(y) << 1 | spreadBits(z) << 2;
+    }
+
+    // systems are sorted in the order they were added
+    SpatialSorter& addSystem(SystemBase* system) {
+        m_targets.emplace_back(system);
+        m_passInProgress = false;
+        return *this;
+    }
+
+    /**
+     * @brief Moves at most maxMoves components into place, starting a new pass if the last one has finished
+     *
+     * @return true if this step finished a pass
+     */
+    bool step(size_t maxMoves) {
+        if (m_targets.empty()) return true;
+        if (!m_passInProgress) beginPass();
+
+        while (maxMoves > 0 && m_currentTarget < m_targets.size()) {
+            Target& target = m_targets[m_currentTarget];
+            SystemBase& system = *target.r_system;
+
+            uint32_t size = uint32_t(system.getEntities().size());
+
+            while (maxMoves > 0 && target.m_next < target.m_order.size() && target.m_slot < size) {
+                const Entity& entity = target.m_order[target.m_next++];
+
+                uint32_t index = system.getComponentIndex(entity);
+                if (index == ~0u) continue;
+
+                // a removal since the pass began can have moved an unsorted component below m_slot, taking it
+                // back out of the sorted range costs a little locality until the next pass but is still correct
+                if (index != target.m_slot) {
+                    system.swapComponents(target.m_slot, index);
+                    maxMoves--;
+                }
+
+                target.m_slot++;
+            }
+
+            if (target.m_next < target.m_order.size() && target.m_slot < size) break;
+
+            target.m_order.clear();
+            m_currentTarget++;
+        }
+
+        if (m_currentTarget < m_targets.size()) return false;
+
+        m_passInProgress = false;
+        m_completedPasses++;
+        return true;
+    }
+
+    // runs the rest of the current pass, or a whole new one, immediately
+    void sortAll() {
+        while (!step(std::numeric_limits<size_t>::max()));
+    }
+
+    size_t getCompletedPasses() const { return m_completedPasses; }
+};
+
+}
+
+#endif
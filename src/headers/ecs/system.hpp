@@ -3,43 +3,237 @@
 
 #include <component.hpp>
 #include <entity.hpp>
-#include <unordered_map>
-#include <unordered_set>
+#include <sparseSet.hpp>
+
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
 
 namespace mge::ecs {
 
 class ECSManager;
 
 class SystemBase {
+    friend class ECSManager;
+
+    // set by ECSManager::addSystem, so the system can keep its entities' signatures up to date
+    std::vector<Signature>* r_signatures = nullptr;
+    ComponentTypeID m_typeID = 0;
+
+    // the ECSManager's change tick, which changed components are stamped with
+    const uint32_t* r_tick = nullptr;
+
+public:
+    typedef std::function<void(std::span<const Entity>)> EntityObserver;
+
+protected:
+    std::vector<EntityObserver> m_constructObservers, m_updateObservers;
+
+    // added since observers were last notified, only recorded while something is observing
+    std::vector<Entity> m_constructed;
+
+    // components changed at or after this tick haven't been reported to on-update observers yet
+    uint32_t m_notifiedTick = 0;
+
+    uint32_t getTick() const { return r_tick ? *r_tick : 0; }
+
+    void markAdded(const Entity& entity) {
+        if (r_signatures && entity.m_index < r_signatures->size())
+            (*r_signatures)[entity.m_index] |= Signature { 1 } << m_typeID;
+
+        if (!m_constructObservers.empty()) m_constructed.push_back(entity);
+    }
+
+    void markRemoved(const Entity& entity) {
+        if (r_signatures && entity.m_index < r_signatures->size())
+            (*r_signatures)[entity.m_index] &= ~(Signature { 1 } << m_typeID);
+    }
+
 public:
-    ECSManager* r_ecsManager;
+    ECSManager* r_ecsManager = nullptr;
 
     virtual void removeComponent(const Entity& entity) = 0;
+
+    virtual void removeComponents(const std::vector<Entity>& entities) {
+        for (const auto& entity : entities) removeComponent(entity);
+    }
+
     virtual Component* getAnonymousComponent(const Entity& entity) = 0;
     virtual Component* addAnonymousComponent(const Entity& entity) = 0;
+
+    // for maintenance passes that reorder storage, the slot of the entity's component or ~0u if it has none
+    virtual const std::vector<Entity>& getEntities() const = 0;
+    virtual uint32_t getComponentIndex(const Entity& entity) const = 0;
+    virtual void swapComponents(uint32_t a, uint32_t b) = 0;
+
+    // for snapshots, which can only store components that are trivially copyable and don't refer to anything
+    // outside the ECS, systems whose components do (e.g. to a renderer instance) opt out
+    virtual bool isSnapshottable() const = 0;
+    virtual size_t getComponentSize() const = 0;
+    virtual const void* getComponentData() const = 0;
+    virtual void loadComponents(std::span<const Entity> entities, const void* components) = 0;
+
+    void onConstruct(EntityObserver observer) { m_constructObservers.push_back(std::move(observer)); }
+    void onUpdate(EntityObserver observer) { m_updateObservers.push_back(std::move(observer)); }
+
+    // delivers everything recorded since the last call in one batch per kind of signal
+    virtual void notifyObservers() = 0;
 };
 
+/**
+ * @brief Stores and updates every component of one type
+ *
+ * Components handed out mutably, by addComponent, getComponent or a view, are stamped with the current change
+ * tick. Code that only reads should use readComponent or a view of const components so they aren't. Writing
+ * through m_components directly doesn't mark anything, call markChanged after.
+ *
+ * Other code can observe components being constructed, updated and destroyed. Signals are batched up and
+ * delivered by notifyObservers, which ECSManager::flush calls on every system, so observers run at a sync
+ * point rather than in the middle of whatever made the change:
+ *
+ * - on-destroy observers get the removed components themselves, moved out of storage, and run first
+ * - on-construct observers get the entities that were given a component and still have it
+ * - on-update observers get every entity whose component was marked as changed since the last batch, including
+ *   ones constructed in it, found by scanning the change versions
+ */
 template<typename Component>
 class System : public SystemBase {
 public:
-    std::unordered_map<Entity, Component> m_components;
+    typedef std::function<void(std::span<const Component>)> ComponentObserver;
+
+private:
+    std::vector<ComponentObserver> m_destroyObservers;
+
+    // removed since observers were last notified, kept alive until on-destroy observers have seen them
+    std::vector<Component> m_destroyed;
+
+    // reused by notifyObservers
+    std::vector<Entity> m_updated;
+
+public:
+    SparseSet<Component> m_components;
 
 // public:
     virtual Component* addComponent(const Entity& entity) {
-        auto result = &m_components[entity];
+        auto result = &m_components.emplace(entity, getTick());
         result->m_entity = entity;
+        markAdded(entity);
         return result;
     }
 
+    // adds a default component to each entity, reserving space for all of them first
+    virtual void addComponents(std::span<const Entity> entities) {
+        m_components.reserve(m_components.size() + entities.size());
+        for (const auto& entity : entities) addComponent(entity);
+    }
+
+    // adds a copy of blueprint to each entity, reserving space for all of them first
+    virtual void addComponents(std::span<const Entity> entities, const Component& blueprint) {
+        // this is virtual, so it's compiled for every system whether or not its components can be copied, but
+        // Prefab::add refuses to compile for those, so only calling it directly can get here
+        if constexpr (!std::is_copy_assignable_v<Component>) {
+            throw std::logic_error("Components of this type can't be copied from a blueprint");
+        } else {
+            m_components.reserve(m_components.size() + entities.size());
+
+            for (const auto& entity : entities) {
+                auto& component = m_components.emplace(entity, getTick());
+                component = blueprint;
+                component.m_entity = entity;
+                markAdded(entity);
+            }
+        }
+    }
+
     virtual Component* getComponent(const Entity& entity) {
-        if (!m_components.contains(entity)) return nullptr;
-        return &m_components[entity];
+        return m_components.touch(entity, getTick());
+    }
+
+    const Component* readComponent(const Entity& entity) const {
+        return m_components.get(entity);
+    }
+
+    void markChanged(const Entity& entity) { m_components.touch(entity, getTick()); }
+
+    // the tick the entity's component was last changed at, or 0 if it doesn't have one
+    uint32_t getLastChanged(const Entity& entity) const { return m_components.getVersion(entity); }
+
+    virtual void removeComponent(const Entity& entity) override {
+        if (!m_destroyObservers.empty())
+        if (auto component = m_components.get(entity))
+            m_destroyed.push_back(std::move(*component));
+
+        if (m_components.erase(entity)) markRemoved(entity);
     }
 
-    virtual void removeComponent(const Entity& entity) override { m_components.erase(entity); }
+    void onDestroy(ComponentObserver observer) { m_destroyObservers.push_back(std::move(observer)); }
+
+    void notifyObservers() override {
+        // observers can add and remove components themselves, which go into the next batch, and each batch is
+        // swapped back afterwards so the storage is reused
+        if (!m_destroyed.empty()) {
+            std::vector<Component> destroyed;
+            std::swap(destroyed, m_destroyed);
+
+            for (auto& observer : m_destroyObservers) observer(destroyed);
+
+            destroyed.clear();
+            if (m_destroyed.empty()) std::swap(destroyed, m_destroyed);
+        }
+
+        if (!m_constructed.empty()) {
+            std::vector<Entity> constructed;
+            std::swap(constructed, m_constructed);
+            std::erase_if(constructed, [&](const Entity& entity) { return !m_components.contains(entity); });
+
+            if (!constructed.empty())
+                for (auto& observer : m_constructObservers) observer(constructed);
+
+            constructed.clear();
+            if (m_constructed.empty()) std::swap(constructed, m_constructed);
+        }
+
+        if (!m_updateObservers.empty()) {
+            std::vector<Entity> updated;
+            std::swap(updated, m_updated);
+
+            const auto& entities = m_components.entities();
+            const uint32_t* versions = m_components.versions();
+            for (size_t i = 0; i < entities.size(); i++)
+                if (versions[i] >= m_notifiedTick) updated.push_back(entities[i]);
+
+            if (!updated.empty())
+                for (auto& observer : m_updateObservers) observer(updated);
+
+            updated.clear();
+            std::swap(updated, m_updated);
+        }
+
+        m_notifiedTick = getTick();
+    }
 
     mge::ecs::Component* addAnonymousComponent(const Entity& entity) override { return addComponent(entity); }
     mge::ecs::Component* getAnonymousComponent(const Entity& entity) override { return getComponent(entity); }
+
+    const std::vector<Entity>& getEntities() const override { return m_components.entities(); }
+    uint32_t getComponentIndex(const Entity& entity) const override { return m_components.indexOf(entity); }
+    void swapComponents(uint32_t a, uint32_t b) override { m_components.swapSlots(a, b); }
+
+    bool isSnapshottable() const override { return std::is_trivially_copyable_v<Component>; }
+    size_t getComponentSize() const override { return sizeof(Component); }
+    const void* getComponentData() const override { return m_components.data(); }
+
+    // bypasses addComponent, so it replaces everything in the system and doesn't touch signatures
+    void loadComponents(std::span<const Entity> entities, const void* components) override {
+        if constexpr (!std::is_trivially_copyable_v<Component>)
+            throw std::logic_error("This component type can't be loaded from raw memory, it isn't trivially copyable");
+        else {
+            m_components.assign(entities, components, getTick());
+            if (!m_constructObservers.empty()) m_constructed.insert(m_constructed.end(), entities.begin(), entities.end());
+        }
+    }
 };
 
 }
@@ -3,25 +3,68 @@
 
 #include <libraries.hpp>
 #include <component.hpp>
+#include <jobSystem.hpp>
+#include <system.hpp>
+#include <transformBatch.hpp>
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace mge::ecs {
 
+/**
+ * @brief Where an entity is, relative to its parent if it has one
+ *
+ * Position, rotation and scale are local, and the matrix and basis vectors are in world space. Transforms
+ * without a parent are the same either way. A child's world matrix is only up to date once
+ * TransformSystem::updateMatrices has propagated its parent's into it.
+ */
 class TransformComponent : public Component {
+    friend class TransformSystem;
+
     glm::vec3 m_position { 0.f };
     glm::quat m_rotation { 0.f, { 0.f, 1.f, 0.f } };
     glm::vec3 m_scale { 1.f };
 
-    bool m_validMatrix = false;
-    glm::mat4 m_matrix;
+    // set through TransformSystem::setParent, which keeps the hierarchy sorted
+    std::optional<Entity> m_parent;
+    glm::mat4 m_parentMatrix { 1.f };
+
+    // cached by the getters, so reading a transform from several threads at once isn't safe until it's been built
+    mutable bool m_validMatrix = false;
+    mutable glm::mat4 m_matrix;
+    mutable glm::vec3 m_right, m_forward, m_up;
 
 public:
-    glm::vec3 getPosition() { return m_position; }
-    glm::quat getRotation() { return m_rotation; }
-    glm::vec3 getScale() { return m_scale; }
+    glm::vec3 getPosition() const { return m_position; }
+    glm::quat getRotation() const { return m_rotation; }
+    glm::vec3 getScale() const { return m_scale; }
+
+    std::optional<Entity> getParent() const { return m_parent; }
+
+    glm::vec3 getWorldPosition() const {
+        if (!m_validMatrix) updateMatrix();
+        return glm::vec3 { m_matrix[3] };
+    }
+
+    glm::vec3 getRight() const {
+        if (!m_validMatrix) updateMatrix();
+        return m_right;
+    }
+
+    glm::vec3 getForward() const {
+        if (!m_validMatrix) updateMatrix();
+        return m_forward;
+    }
 
-    glm::vec3 getRight() { return glm::normalize(getMat3()[0]); }
-    glm::vec3 getForward() { return glm::normalize(getMat3()[1]); }
-    glm::vec3 getUp() { return glm::normalize(getMat3()[2]); }
+    glm::vec3 getUp() const {
+        if (!m_validMatrix) updateMatrix();
+        return m_up;
+    }
 
     void setPosition(glm::vec3 position) {
         m_position = position;
@@ -38,23 +81,347 @@ public:
         m_validMatrix = false;
     }
 
-    void updateMatrix() {
+    void updateMatrix() const {
         m_matrix = glm::translate(glm::mat4 { 1.f }, m_position)
                  * glm::scale(glm::mat4 { 1.f }, m_scale)
                  * glm::toMat4(m_rotation);
+        if (m_parent) m_matrix = m_parentMatrix * m_matrix;
+
+        m_right = glm::normalize(glm::vec3 { m_matrix[0] });
+        m_forward = glm::normalize(glm::vec3 { m_matrix[1] });
+        m_up = glm::normalize(glm::vec3 { m_matrix[2] });
+        m_validMatrix = true;
     }
 
-    glm::mat4 getMat4() {
+    glm::mat4 getMat4() const {
         if (!m_validMatrix) updateMatrix();
         return m_matrix;
     }
 
-    glm::mat3 getMat3() {
+    glm::mat3 getMat3() const {
         if (!m_validMatrix) updateMatrix();
         return glm::mat3 { m_matrix };
     }
 };
 
+/**
+ * @brief Stores transforms, keeps their hierarchy, and rebuilds every stale matrix in one batched pass
+ *
+ * updateMatrices first propagates world matrices down the hierarchy, then copies the position, rotation and scale
+ * of every other transform whose matrix is out of date into a TransformBatch, composes them several at a time
+ * with SIMD and writes the matrices and basis vectors back. Call it once things have stopped moving for the
+ * frame, so that reading getMat4 or getForward afterwards doesn't build each matrix on its own, and so it's safe
+ * from several threads.
+ *
+ * Transforms with a parent or children are kept in breadth first order, so every parent is updated before its
+ * children in one pass over the array. Only subtrees under a transform that changed are recomputed, and children
+ * are marked as changed when their parent moves them, so views of changed transforms see them too.
+ *
+ * World matrices are also double buffered per tick, for motion vectors and for interpolating between fixed
+ * steps. swapBuffers ends a tick: the buffers are swapped and only transforms that changed during the tick are
+ * written into the new current one. A transform that keeps moving never has its matrix copied between them.
+ */
+class TransformSystem : public System<TransformComponent> {
+    TransformBatch m_batch;
+
+    // the slots of the components being rebuilt, parallel to m_batch
+    std::vector<uint32_t> m_stale;
+
+    struct Node {
+        Entity m_entity;
+        uint32_t m_parent;
+
+        // the change version the world matrix was last computed at, it needs recomputing if that has moved on
+        uint32_t m_version = ~0u;
+        bool m_dirty = true;
+    };
+
+    static constexpr uint32_t NO_PARENT = ~0u;
+
+    // world matrices by component slot, kept in step with m_components as it's reordered
+    struct WorldBuffer {
+        std::vector<glm::mat4> m_matrices;
+
+        // the tick each matrix was written in, 0 if it hasn't been
+        std::vector<uint32_t> m_ticks;
+
+        void resize(size_t size) {
+            m_matrices.resize(size);
+            m_ticks.resize(size, 0);
+        }
+
+        void swap(uint32_t a, uint32_t b) {
+            std::swap(m_matrices[a], m_matrices[b]);
+            std::swap(m_ticks[a], m_ticks[b]);
+        }
+
+        // mirrors the swap and pop of SparseSet::erase
+        void erase(uint32_t slot) {
+            m_matrices[slot] = m_matrices.back();
+            m_ticks[slot] = m_ticks.back();
+            m_matrices.pop_back();
+            m_ticks.pop_back();
+        }
+    };
+
+    WorldBuffer m_current, m_previous;
+    uint32_t m_tick = 1;
+
+    // transforms changed at or after this change tick haven't been written to the buffers yet
+    uint32_t m_swappedChangeTick = 0;
+
+    // slots added since the last swap get entries that haven't been written
+    void fitBuffers() {
+        if (m_current.m_ticks.size() == m_components.size()) return;
+        m_current.resize(m_components.size());
+        m_previous.resize(m_components.size());
+    }
+
+    // breadth first, so each node comes after its parent
+    std::vector<Node> m_hierarchy;
+    std::unordered_set<Entity> m_parents;
+    bool m_hierarchyChanged = false;
+
+    void rebuildHierarchy() {
+        m_hierarchy.clear();
+        m_parents.clear();
+        m_hierarchyChanged = false;
+
+        // only happens when parents are set or transforms in the hierarchy are removed, so every transform is
+        // scanned rather than keeping the links up to date
+        std::unordered_map<Entity, std::vector<Entity>> children;
+
+        for (auto& comp : m_components) {
+            if (!comp.m_parent) continue;
+
+            if (m_components.contains(*comp.m_parent)) {
+                children[*comp.m_parent].push_back(comp.m_entity);
+                m_parents.insert(*comp.m_parent);
+            } else detach(comp);
+        }
+
+        for (auto& comp : m_components)
+            if (!comp.m_parent && m_parents.contains(comp.m_entity))
+                m_hierarchy.push_back({ comp.m_entity, NO_PARENT });
+
+        for (uint32_t i = 0; i < m_hierarchy.size(); i++) {
+            auto it = children.find(m_hierarchy[i].m_entity);
+            if (it == children.end()) continue;
+
+            for (const auto& child : it->second) m_hierarchy.push_back({ child, i });
+        }
+    }
+
+    // the transform keeps its local position, rotation and scale, which become its world ones
+    void detach(TransformComponent& comp) {
+        comp.m_parent.reset();
+        comp.m_parentMatrix = glm::mat4 { 1.f };
+        comp.m_validMatrix = false;
+        markChanged(comp.m_entity);
+    }
+
+public:
+    /**
+     * @brief Attaches child to parent, or detaches it if parent is empty
+     *
+     * The child's position, rotation and scale are kept as they are, and from now on are relative to the parent.
+     * Throws std::logic_error if either entity has no transform or if it would make a cycle.
+     */
+    void setParent(const Entity& child, std::optional<Entity> parent) {
+        auto comp = m_components.get(child);
+        if (!comp) throw std::logic_error("Can't parent an entity without a transform");
+
+        if (parent) {
+            if (!m_components.contains(*parent)) throw std::logic_error("Can't parent a transform to an entity without one");
+
+            for (auto ancestor = parent; ancestor; ) {
+                if (*ancestor == child) throw std::logic_error("Can't parent a transform to one of its own children");
+                auto ancestorComp = m_components.get(*ancestor);
+                ancestor = ancestorComp ? ancestorComp->m_parent : std::nullopt;
+            }
+
+            comp->m_parent = parent;
+            comp->m_validMatrix = false;
+            markChanged(child);
+        } else if (comp->m_parent) detach(*comp);
+
+        m_hierarchyChanged = true;
+    }
+
+    // brings the world matrix of every transform in the hierarchy up to date, updateMatrices does this first
+    void updateHierarchy() {
+        if (m_hierarchyChanged) rebuildHierarchy();
+
+        for (auto& node : m_hierarchy) {
+            auto& comp = m_components[m_components.indexOf(node.m_entity)];
+            bool parentDirty = node.m_parent != NO_PARENT && m_hierarchy[node.m_parent].m_dirty;
+            node.m_dirty = parentDirty || !comp.m_validMatrix || m_components.getVersion(node.m_entity) != node.m_version;
+
+            if (!node.m_dirty) continue;
+
+            // the parent has already been brought up to date, it comes earlier
+            if (node.m_parent != NO_PARENT)
+                comp.m_parentMatrix = m_components.get(m_hierarchy[node.m_parent].m_entity)->m_matrix;
+
+            if (parentDirty) markChanged(node.m_entity);
+            comp.updateMatrix();
+            node.m_version = m_components.getVersion(node.m_entity);
+        }
+    }
+
+    /**
+     * @brief Ends a tick, so the world matrices as of now become the current ones and the last current ones the
+     * previous ones
+     *
+     * Call it once per simulation step, after everything has moved. Only transforms marked as changed since the
+     * last swap are written. The matrix from before the tick is only copied into the previous buffer when a
+     * transform starts moving after being still.
+     */
+    void swapBuffers() {
+        std::swap(m_current, m_previous);
+        m_tick++;
+        fitBuffers();
+
+        const uint32_t* versions = m_components.versions();
+
+        for (uint32_t slot = 0; slot < m_components.size(); slot++) {
+            bool written = m_current.m_ticks[slot] != 0 || m_previous.m_ticks[slot] != 0;
+            if (written && versions[slot] < m_swappedChangeTick) continue;
+
+            glm::mat4 matrix = m_components[slot].getMat4();
+
+            // the previous buffer has to end up with the latest matrix from before this tick
+            if (!written) {
+                m_previous.m_matrices[slot] = matrix;
+                m_previous.m_ticks[slot] = m_tick - 1;
+            } else if (m_current.m_ticks[slot] > m_previous.m_ticks[slot]) {
+                m_previous.m_matrices[slot] = m_current.m_matrices[slot];
+                m_previous.m_ticks[slot] = m_current.m_ticks[slot];
+            }
+
+            m_current.m_matrices[slot] = matrix;
+            m_current.m_ticks[slot] = m_tick;
+        }
+
+        m_swappedChangeTick = getTick();
+    }
+
+    // the world matrix as of the last swap, or as it is now if the transform hasn't been through one
+    glm::mat4 getCurrentMatrix(const Entity& entity) const {
+        uint32_t slot = m_components.indexOf(entity);
+        if (slot == SparseSet<TransformComponent>::INVALID_INDEX) return glm::mat4 { 1.f };
+        if (slot >= m_current.m_ticks.size() || (m_current.m_ticks[slot] == 0 && m_previous.m_ticks[slot] == 0))
+            return m_components[slot].getMat4();
+
+        return m_current.m_ticks[slot] >= m_previous.m_ticks[slot] ? m_current.m_matrices[slot] : m_previous.m_matrices[slot];
+    }
+
+    // the world matrix as of the swap before last, the same as the current one if it didn't move in between
+    glm::mat4 getPreviousMatrix(const Entity& entity) const {
+        uint32_t slot = m_components.indexOf(entity);
+        if (slot != SparseSet<TransformComponent>::INVALID_INDEX && slot < m_current.m_ticks.size() && m_current.m_ticks[slot] == m_tick)
+            return m_previous.m_matrices[slot];
+
+        return getCurrentMatrix(entity);
+    }
+
+    // between the previous and current matrices, which is close enough for the small changes in one tick
+    glm::mat4 getInterpolatedMatrix(const Entity& entity, float alpha) const {
+        glm::mat4 previous = getPreviousMatrix(entity);
+        return previous + (getCurrentMatrix(entity) - previous) * alpha;
+    }
+
+    void removeComponent(const Entity& entity) override {
+        if (auto comp = m_components.get(entity); comp && (comp->m_parent || m_parents.contains(entity)))
+            m_hierarchyChanged = true;
+
+        fitBuffers();
+        uint32_t slot = m_components.indexOf(entity);
+
+        System<TransformComponent>::removeComponent(entity);
+
+        if (slot != SparseSet<TransformComponent>::INVALID_INDEX) {
+            m_current.erase(slot);
+            m_previous.erase(slot);
+        }
+    }
+
+    void swapComponents(uint32_t a, uint32_t b) override {
+        fitBuffers();
+        System<TransformComponent>::swapComponents(a, b);
+        m_current.swap(a, b);
+        m_previous.swap(a, b);
+    }
+
+    void loadComponents(std::span<const Entity> entities, const void* components) override {
+        System<TransformComponent>::loadComponents(entities, components);
+        m_hierarchyChanged = true;
+
+        // the loaded transforms start without any history
+        m_current.resize(0);
+        m_previous.resize(0);
+    }
+
+    // spread across the job system when one is given and there's more than one grain of work
+    void updateMatrices(JobSystem* jobSystem = nullptr, size_t grainSize = 4'096) {
+        updateHierarchy();
+
+        m_stale.clear();
+        for (uint32_t i = 0; i < m_components.size(); i++)
+            if (!m_components[i].m_validMatrix) m_stale.push_back(i);
+
+        if (m_stale.empty()) return;
+
+        m_batch.resize(m_stale.size());
+
+        auto update = [this](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const auto& comp = m_components[m_stale[i]];
+
+                const float position[3] = { comp.m_position.x, comp.m_position.y, comp.m_position.z };
+                const float rotation[4] = { comp.m_rotation.x, comp.m_rotation.y, comp.m_rotation.z, comp.m_rotation.w };
+                const float scale[3] = { comp.m_scale.x, comp.m_scale.y, comp.m_scale.z };
+                m_batch.set(i, position, rotation, scale);
+            }
+
+            m_batch.compose(begin, end);
+
+            for (size_t i = begin; i < end; i++) {
+                auto& comp = m_components[m_stale[i]];
+                auto column = [&](const std::vector<float>* arrays, int c) {
+                    return glm::vec3 { arrays[c * 3][i], arrays[c * 3 + 1][i], arrays[c * 3 + 2][i] };
+                };
+
+                comp.m_matrix = glm::mat4 {
+                    glm::vec4 { column(m_batch.m_columns, 0), 0.f },
+                    glm::vec4 { column(m_batch.m_columns, 1), 0.f },
+                    glm::vec4 { column(m_batch.m_columns, 2), 0.f },
+                    glm::vec4 { comp.m_position, 1.f },
+                };
+
+                comp.m_right = column(m_batch.m_basis, 0);
+                comp.m_forward = column(m_batch.m_basis, 1);
+                comp.m_up = column(m_batch.m_basis, 2);
+                comp.m_validMatrix = true;
+            }
+        };
+
+        // grains have to start on a whole number of lanes
+        grainSize = std::max(grainSize / TransformBatch::LANES, size_t { 1 }) * TransformBatch::LANES;
+
+        if (!jobSystem || m_stale.size() <= grainSize) {
+            update(0, m_stale.size());
+            return;
+        }
+
+        size_t grains = (m_stale.size() + grainSize - 1) / grainSize;
+        jobSystem->parallelFor(0, grains, 1, [&](size_t begin, size_t end) {
+            for (size_t grain = begin; grain < end; grain++)
+                update(grain * grainSize, std::min((grain + 1) * grainSize, m_stale.size()));
+        });
+    }
+};
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,159 @@
+#ifndef TRANSFORMBATCH_HPP
+#define TRANSFORMBATCH_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MGE_TRANSFORM_SSE
+#include <emmintrin.h>
+#endif
+
+namespace mge::ecs {
+
+namespace detail {
+
+// a handful of floats operated on together, as wide as the target allows
+#if defined(__AVX__)
+struct Lanes {
+    static constexpr size_t COUNT = 8;
+    __m256 m_value;
+
+    static Lanes load(const float* data) { return { _mm256_loadu_ps(data) }; }
+    static Lanes splat(float value) { return { _mm256_set1_ps(value) }; }
+    void store(float* data) const { _mm256_storeu_ps(data, m_value); }
+
+    friend Lanes operator+(Lanes a, Lanes b) { return { _mm256_add_ps(a.m_value, b.m_value) }; }
+    friend Lanes operator-(Lanes a, Lanes b) { return { _mm256_sub_ps(a.m_value, b.m_value) }; }
+    friend Lanes operator*(Lanes a, Lanes b) { return { _mm256_mul_ps(a.m_value, b.m_value) }; }
+    friend Lanes operator/(Lanes a, Lanes b) { return { _mm256_div_ps(a.m_value, b.m_value) }; }
+    friend Lanes sqrt(Lanes a) { return { _mm256_sqrt_ps(a.m_value) }; }
+};
+#elif defined(MGE_TRANSFORM_SSE)
+struct Lanes {
+    static constexpr size_t COUNT = 4;
+    __m128 m_value;
+
+    static Lanes load(const float* data) { return { _mm_loadu_ps(data) }; }
+    static Lanes splat(float value) { return { _mm_set1_ps(value) }; }
+    void store(float* data) const { _mm_storeu_ps(data, m_value); }
+
+    friend Lanes operator+(Lanes a, Lanes b) { return { _mm_add_ps(a.m_value, b.m_value) }; }
+    friend Lanes operator-(Lanes a, Lanes b) { return { _mm_sub_ps(a.m_value, b.m_value) }; }
+    friend Lanes operator*(Lanes a, Lanes b) { return { _mm_mul_ps(a.m_value, b.m_value) }; }
+    friend Lanes operator/(Lanes a, Lanes b) { return { _mm_div_ps(a.m_value, b.m_value) }; }
+    friend Lanes sqrt(Lanes a) { return { _mm_sqrt_ps(a.m_value) }; }
+};
+#else
+struct Lanes {
+    static constexpr size_t COUNT = 1;
+    float m_value;
+
+    static Lanes load(const float* data) { return { *data }; }
+    static Lanes splat(float value) { return { value }; }
+    void store(float* data) const { *data = m_value; }
+
+    friend Lanes operator+(Lanes a, Lanes b) { return { a.m_value + b.m_value }; }
+    friend Lanes operator-(Lanes a, Lanes b) { return { a.m_value - b.m_value }; }
+    friend Lanes operator*(Lanes a, Lanes b) { return { a.m_value * b.m_value }; }
+    friend Lanes operator/(Lanes a, Lanes b) { return { a.m_value / b.m_value }; }
+    friend Lanes sqrt(Lanes a) { return { std::sqrt(a.m_value) }; }
+};
+#endif
+
+}
+
+/**
+ * @brief Structure of arrays staging for composing many transforms at once
+ *
+ * Each input and output is one array per scalar, so compose() works on LANES transforms per iteration with SSE,
+ * or AVX when it's enabled. It computes the same matrix as TransformComponent::updateMatrix,
+ * translate * scale * rotation, and doesn't depend on glm so it can be benchmarked on its own. The translation
+ * column is just the position, so it isn't stored again.
+ *
+ *     batch.resize(count);
+ *     for (size_t i = 0; i < count; i++) batch.set(i, position, rotation, scale);
+ *     batch.compose(0, count);
+ */
+class TransformBatch {
+public:
+    static constexpr size_t LANES = detail::Lanes::COUNT;
+
+    // rotations are x, y, z, w, and don't have to be normalised
+    std::vector<float> m_position[3], m_rotation[4], m_scale[3];
+
+    // the upper 3x3 of the matrix, m_columns[column * 3 + row], and each of its columns normalised
+    std::vector<float> m_columns[9], m_basis[9];
+
+    size_t size() const { return m_size; }
+
+    // every transform up to size has to be set before composing, the rest are padded with identity transforms
+    // to a whole number of LANES
+    void resize(size_t size) {
+        m_size = size;
+        size_t padded = (size + LANES - 1) / LANES * LANES;
+
+        auto pad = [&](std::vector<float>& array, float value) {
+            array.resize(padded);
+            std::fill(array.begin() + size, array.end(), value);
+        };
+
+        for (auto& array : m_position) pad(array, 0.f);
+        for (int i = 0; i < 4; i++) pad(m_rotation[i], i == 3 ? 1.f : 0.f);
+        for (auto& array : m_scale) pad(array, 1.f);
+        for (auto& array : m_columns) array.resize(padded);
+        for (auto& array : m_basis) array.resize(padded);
+    }
+
+    void set(size_t index, const float position[3], const float rotation[4], const float scale[3]) {
+        for (int i = 0; i < 3; i++) m_position[i][index] = position[i];
+        for (int i = 0; i < 4; i++) m_rotation[i][index] = rotation[i];
+        for (int i = 0; i < 3; i++) m_scale[i][index] = scale[i];
+    }
+
+    // begin has to be a multiple of LANES, the last group is finished off with padding
+    void compose(size_t begin, size_t end) {
+        using detail::Lanes;
+
+        const Lanes one = Lanes::splat(1.f), two = Lanes::splat(2.f);
+
+        for (size_t i = begin; i < end; i += LANES) {
+            Lanes x = Lanes::load(&m_rotation[0][i]), y = Lanes::load(&m_rotation[1][i]);
+            Lanes z = Lanes::load(&m_rotation[2][i]), w = Lanes::load(&m_rotation[3][i]);
+            Lanes sx = Lanes::load(&m_scale[0][i]), sy = Lanes::load(&m_scale[1][i]), sz = Lanes::load(&m_scale[2][i]);
+
+            Lanes xx = x * x, yy = y * y, zz = z * z;
+            Lanes xy = x * y, xz = x * z, yz = y * z;
+            Lanes wx = w * x, wy = w * y, wz = w * z;
+
+            // glm::toMat4, with the scale applied to each row because it comes after the rotation
+            Lanes columns[9] = {
+                (one - two * (yy + zz)) * sx, two * (xy + wz) * sy, two * (xz - wy) * sz,
+                two * (xy - wz) * sx, (one - two * (xx + zz)) * sy, two * (yz + wx) * sz,
+                two * (xz + wy) * sx, two * (yz - wx) * sy, (one - two * (xx + yy)) * sz,
+            };
+
+            for (int c = 0; c < 3; c++) {
+                Lanes length = sqrt(columns[c * 3] * columns[c * 3]
+                                  + columns[c * 3 + 1] * columns[c * 3 + 1]
+                                  + columns[c * 3 + 2] * columns[c * 3 + 2]);
+
+                for (int r = 0; r < 3; r++) {
+                    columns[c * 3 + r].store(&m_columns[c * 3 + r][i]);
+                    (columns[c * 3 + r] / length).store(&m_basis[c * 3 + r][i]);
+                }
+            }
+        }
+    }
+
+private:
+    size_t m_size = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef VIEW_HPP
+#define VIEW_HPP
+
+#include <system.hpp>
+#include <entity.hpp>
+#include <jobSystem.hpp>
+
+#include <array>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mge::ecs {
+
+/**
+ * @brief Iterates every entity that has all of the given components
+ *
+ * Walks the packed entity array of the smallest of the requested systems and joins the others through their
+ * sparse index, yielding the entity along with a reference to each of its components:
+ *
+ *     for (auto [ entity, transform, rigidbody ] : ecs.view<TransformComponent, RigidbodyComponent>())
+ *
+ * Every component visited is marked as changed unless it's viewed as const, and changedSince skips entities
+ * none of whose viewed components have changed recently:
+ *
+ *     for (auto [ entity, transform ] : ecs.view<const TransformComponent>().changedSince(lastTick))
+ *
+ * Adding or removing components of the viewed types while iterating invalidates the references it hands out.
+ * A view of a component type that has no system yields nothing.
+ */
+template<typename... Components>
+class View {
+    static constexpr uint32_t INVALID_INDEX = ~0u;
+
+    // what a view of a missing system walks
+    static inline const std::vector<Entity> s_noEntities;
+
+    std::tuple<System<std::remove_const_t<Components>>*...> m_systems;
+    const std::vector<Entity>* r_entities = nullptr;
+    uint32_t m_tick = 0;
+    uint32_t m_changedSince = 0;
+
+    static const std::vector<Entity>* smallest(System<std::remove_const_t<Components>>*... systems) {
+        if (!(systems && ...)) return &s_noEntities;
+
+        const std::vector<Entity>* result = nullptr;
+        ((result = !result || systems->m_components.size() < result->size() ? &systems->m_components.entities() : result), ...);
+        return result;
+    }
+
+    template<typename Component>
+    System<std::remove_const_t<Component>>* getSystem() const {
+        return std::get<System<std::remove_const_t<Component>>*>(m_systems);
+    }
+
+    // the entity's slot in the component's system, the driving system's is just where the view is up to
+    template<typename Component>
+    uint32_t slotOf(const Entity& entity, size_t index) const {
+        const auto& components = getSystem<Component>()->m_components;
+        if (&components.entities() == r_entities) return static_cast<uint32_t>(index);
+        return components.indexOf(entity);
+    }
+
+public:
+    class Iterator {
+        friend class View;
+
+        const View* r_view;
+        size_t m_index, m_end;
+        std::tuple<Components*...> m_current;
+
+        // each slot is looked up once, then the version is read and stamped and the component found through it
+        template<size_t... I>
+        bool match(const Entity& entity, std::index_sequence<I...>) {
+            std::array<uint32_t, sizeof...(Components)> slots;
+            if (!(((slots[I] = r_view->template slotOf<Components>(entity, m_index)) != INVALID_INDEX) && ...)) return false;
+
+            if (r_view->m_changedSince
+                && !((r_view->template getSystem<Components>()->m_components.versions()[slots[I]] >= r_view->m_changedSince) || ...))
+                return false;
+
+            ([&] {
+                auto& components = r_view->template getSystem<Components>()->m_components;
+                if constexpr (!std::is_const_v<Components>) components.versions()[slots[I]] = r_view->m_tick;
+                std::get<I>(m_current) = &components[slots[I]];
+            }(), ...);
+
+            return true;
+        }
+
+        // advances to the next entity that has every component, starting from m_index
+        void findMatch() {
+            const auto& entities = *r_view->r_entities;
+
+            for (; m_index < m_end; m_index++)
+                if (match(entities[m_index], std::index_sequence_for<Components...> {})) return;
+        }
+
+    public:
+        // stops at end, so that parallelEach's ranges never look at each other's entities
+        Iterator(const View* view, size_t index, size_t end) : r_view(view), m_index(index), m_end(end) { findMatch(); }
+
+        std::tuple<Entity, Components&...> operator*() const {
+            return { (*r_view->r_entities)[m_index], *std::get<Components*>(m_current)... };
+        }
+
+        Iterator& operator++() {
+            m_index++;
+            findMatch();
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const { return m_index == other.m_index; }
+    };
+
+    // changed components are stamped with tick
+    View(uint32_t tick, System<std::remove_const_t<Components>>*... systems) :
+        m_systems(systems...),
+        r_entities(smallest(systems...)),
+        m_tick(tick)
+    {}
+
+    // only visits entities with at least one of the viewed components changed at or after the given tick
+    View changedSince(uint32_t tick) const {
+        View result = *this;
+        result.m_changedSince = tick;
+        return result;
+    }
+
+    Iterator begin() const { return Iterator(this, 0, r_entities->size()); }
+    Iterator end() const { return Iterator(this, r_entities->size(), r_entities->size()); }
+
+    // calls func(entity, components...) for every match
+    template<typename Func>
+    void each(Func&& func) const {
+        for (auto it = begin(), last = end(); it != last; ++it)
+            std::apply(func, *it);
+    }
+
+    // like each, but splits the entities across the job system in chunks of grainSize
+    template<typename Func>
+    void parallelEach(JobSystem& jobs, Func&& func, size_t grainSize = 256) const {
+        jobs.parallelFor(0, r_entities->size(), grainSize, [&](size_t rangeBegin, size_t rangeEnd) {
+            for (Iterator it { this, rangeBegin, rangeEnd }; it.m_index < rangeEnd; ++it)
+                std::apply(func, *it);
+        });
+    }
+};
+
+}
+
+#endif
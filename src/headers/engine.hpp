@@ -2,6 +2,8 @@
 #define ENGINE_HPP
 
 #include <libraries.hpp>
+#include <jobSystem.hpp>
+#include <frameArena.hpp>
 
 #include <chrono>
 
@@ -25,6 +27,12 @@ public:
 
     std::chrono::high_resolution_clock::time_point m_startTime, m_lastFrameTime;
 
+    // worker threads for anything that wants to run in parallel with the main loop's update
+    JobSystem m_jobSystem;
+
+    // scratch memory for the current frame's update and updateBuffers, reset at the start of every frame
+    FrameArena m_frameArena;
+
     struct QueueFamilies {
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
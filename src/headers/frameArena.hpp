@@ -0,0 +1,114 @@
+#ifndef FRAMEARENA_HPP
+#define FRAMEARENA_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace mge {
+
+/**
+ * @brief A bump allocator for data that only lives until the end of the frame
+ *
+ * Allocating is a single atomic add into one preallocated block, so it's safe from any thread, and
+ * deallocating does nothing at all. Everything is freed at once by reset(). It's a std::pmr::memory_resource,
+ * so containers use it through std::pmr allocators:
+ *
+ *     std::pmr::vector<CollisionEvent> events { &m_frameArena };
+ *
+ * If a frame needs more than the block holds, the rest comes from the heap and the block is grown at the next
+ * reset, so once a scene has warmed up a frame doesn't touch the global allocator.
+ */
+class FrameArena : public std::pmr::memory_resource {
+    static constexpr size_t BLOCK_ALIGNMENT = 64;
+
+    struct Overflow {
+        void* m_pointer;
+        size_t m_size, m_alignment;
+    };
+
+    std::byte* m_block = nullptr;
+    size_t m_capacity = 0;
+    std::atomic<size_t> m_offset = 0;
+
+    // allocations that didn't fit in the block this frame
+    std::mutex m_overflowMutex;
+    std::vector<Overflow> m_overflow;
+    size_t m_overflowBytes = 0;
+
+    void allocateBlock(size_t capacity) {
+        if (m_block) ::operator delete(m_block, std::align_val_t { BLOCK_ALIGNMENT });
+        m_block = static_cast<std::byte*>(::operator new(capacity, std::align_val_t { BLOCK_ALIGNMENT }));
+        m_capacity = capacity;
+    }
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        if (alignment <= BLOCK_ALIGNMENT) {
+            size_t offset = m_offset.load(std::memory_order_relaxed);
+            size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+
+            while (aligned + bytes <= m_capacity) {
+                if (m_offset.compare_exchange_weak(offset, aligned + bytes, std::memory_order_relaxed))
+                    return m_block + aligned;
+
+                aligned = (offset + alignment - 1) & ~(alignment - 1);
+            }
+        }
+
+        std::lock_guard lock { m_overflowMutex };
+        void* result = ::operator new(bytes, std::align_val_t { alignment });
+        m_overflow.push_back({ result, bytes, alignment });
+        m_overflowBytes += bytes + alignment;
+        return result;
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+    explicit FrameArena(size_t capacity = 1 << 20) { allocateBlock(capacity); }
+
+    ~FrameArena() {
+        reset();
+        ::operator delete(m_block, std::align_val_t { BLOCK_ALIGNMENT });
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    /**
+     * @brief Frees everything allocated since the last reset
+     *
+     * Nothing allocated from the arena may be used afterwards, so call it at the start of a frame, before
+     * anything has allocated from it and while no other thread can.
+     */
+    void reset() {
+        for (auto& overflow : m_overflow)
+            ::operator delete(overflow.m_pointer, overflow.m_size, std::align_val_t { overflow.m_alignment });
+
+        if (m_overflowBytes > 0) {
+            size_t needed = m_offset.load(std::memory_order_relaxed) + m_overflowBytes;
+            size_t capacity = std::max(m_capacity, BLOCK_ALIGNMENT);
+            while (capacity < needed) capacity *= 2;
+            allocateBlock(capacity);
+        }
+
+        m_overflow.clear();
+        m_overflowBytes = 0;
+        m_offset.store(0, std::memory_order_relaxed);
+    }
+
+    size_t getCapacity() const { return m_capacity; }
+
+    // bytes handed out since the last reset, including any that overflowed onto the heap
+    size_t getUsed() const { return m_offset.load(std::memory_order_relaxed) + m_overflowBytes; }
+};
+
+}
+
+#endif
@@ -147,12 +147,10 @@ void MODEL::updateInstanceBuffer(int index) {
 
     void* mappedMemory = r_engine.m_device.mapMemory(m_instanceBufferMemories[index], 0, requiredBufferSize);
 
-    std::vector<MeshInstance> meshInstances;
-    meshInstances.reserve(m_meshInstances.size());
+    // written straight into the mapped buffer in order, rather than gathered into a temporary and copied
+    auto mappedInstances = static_cast<MeshInstance*>(mappedMemory);
     for (auto& [ID, inst] : m_meshInstances)
-        meshInstances.push_back(inst);
-    
-    memcpy(mappedMemory, meshInstances.data(), requiredBufferSize);
+        *mappedInstances++ = inst;
 
     r_engine.m_device.unmapMemory(m_instanceBufferMemories[index]);
 }
@@ -0,0 +1,283 @@
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mge {
+
+class JobSystem;
+
+/**
+ * @brief Counts the jobs submitted against it so they can be waited on together
+ *
+ * A group must outlive every job submitted against it, which JobSystem::wait guarantees.
+ */
+class TaskGroup {
+    friend class JobSystem;
+
+    std::mutex m_mutex;
+    size_t m_pending = 0;
+    std::exception_ptr m_exception;
+
+    std::function<void()> m_continuation;
+    TaskGroup* r_continuationGroup = nullptr;
+
+public:
+    TaskGroup() = default;
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    bool isDone() {
+        std::lock_guard lock { m_mutex };
+        return m_pending == 0;
+    }
+};
+
+/**
+ * @brief A work-stealing job system
+ *
+ * Every worker thread has its own deque of jobs. Workers push and pop their own jobs from the back, so nested
+ * work stays hot in cache, and when they run out they steal the oldest job from the front of another queue.
+ * Threads outside the job system share one extra queue.
+ *
+ * Waiting on a group runs other jobs rather than blocking, so jobs can submit and wait on more jobs safely.
+ * With no worker threads, jobs only run while some thread is waiting.
+ */
+class JobSystem {
+public:
+    typedef std::function<void()> Job;
+
+private:
+    struct Entry {
+        Job m_job;
+        TaskGroup* r_group;
+    };
+
+    struct Queue {
+        std::mutex m_mutex;
+        std::deque<Entry> m_entries;
+    };
+
+    // one queue per worker, and a final queue for every other thread
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::atomic<size_t> m_queuedJobs = 0;
+    std::atomic<bool> m_stopping = false;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCondition;
+
+    inline static thread_local JobSystem* t_jobSystem = nullptr;
+    inline static thread_local size_t t_queueIndex = 0;
+
+    size_t getLocalQueueIndex() const {
+        return t_jobSystem == this ? t_queueIndex : m_queues.size() - 1;
+    }
+
+    bool popLocal(size_t index, Entry& entry) {
+        Queue& queue = *m_queues[index];
+        std::lock_guard lock { queue.m_mutex };
+        if (queue.m_entries.empty()) return false;
+
+        entry = std::move(queue.m_entries.back());
+        queue.m_entries.pop_back();
+        m_queuedJobs--;
+        return true;
+    }
+
+    bool steal(size_t thief, Entry& entry) {
+        for (size_t offset = 1; offset < m_queues.size(); offset++) {
+            Queue& queue = *m_queues[(thief + offset) % m_queues.size()];
+            std::lock_guard lock { queue.m_mutex };
+            if (queue.m_entries.empty()) continue;
+
+            entry = std::move(queue.m_entries.front());
+            queue.m_entries.pop_front();
+            m_queuedJobs--;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool tryRunOne() {
+        size_t index = getLocalQueueIndex();
+
+        Entry entry;
+        if (!popLocal(index, entry) && !steal(index, entry)) return false;
+
+        try {
+            entry.m_job();
+        } catch (...) {
+            std::lock_guard lock { entry.r_group->m_mutex };
+            if (!entry.r_group->m_exception) entry.r_group->m_exception = std::current_exception();
+        }
+
+        finish(*entry.r_group);
+        return true;
+    }
+
+    void finish(TaskGroup& group) {
+        Job continuation;
+        TaskGroup* continuationGroup = nullptr;
+
+        {
+            std::lock_guard lock { group.m_mutex };
+            if (--group.m_pending == 0) {
+                std::swap(continuation, group.m_continuation);
+                continuationGroup = group.r_continuationGroup;
+                group.r_continuationGroup = nullptr;
+            }
+        }
+
+        // the continuation was already counted against its group when it was registered
+        if (continuation) push(*continuationGroup, std::move(continuation));
+    }
+
+    void push(TaskGroup& group, Job job) {
+        Queue& queue = *m_queues[getLocalQueueIndex()];
+
+        {
+            std::lock_guard lock { queue.m_mutex };
+            queue.m_entries.push_back({ std::move(job), &group });
+            m_queuedJobs++;
+        }
+
+        {
+            std::lock_guard lock { m_sleepMutex };
+        }
+
+        m_sleepCondition.notify_one();
+    }
+
+    void workerLoop(size_t index) {
+        t_jobSystem = this;
+        t_queueIndex = index;
+
+        while (!m_stopping) {
+            if (tryRunOne()) continue;
+
+            std::unique_lock lock { m_sleepMutex };
+            m_sleepCondition.wait(lock, [&]{ return m_stopping || m_queuedJobs > 0; });
+        }
+    }
+
+public:
+    static size_t getDefaultThreadCount() {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+
+    explicit JobSystem(size_t threadCount = getDefaultThreadCount()) {
+        for (size_t i = 0; i < threadCount + 1; i++)
+            m_queues.push_back(std::make_unique<Queue>());
+
+        for (size_t i = 0; i < threadCount; i++)
+            m_threads.emplace_back([this, i]{ workerLoop(i); });
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    ~JobSystem() {
+        {
+            std::lock_guard lock { m_sleepMutex };
+            m_stopping = true;
+        }
+
+        m_sleepCondition.notify_all();
+        for (auto& thread : m_threads) thread.join();
+    }
+
+    size_t getThreadCount() const { return m_threads.size(); }
+
+    void submit(TaskGroup& group, Job job) {
+        {
+            std::lock_guard lock { group.m_mutex };
+            group.m_pending++;
+        }
+
+        push(group, std::move(job));
+    }
+
+    /**
+     * @brief Submits continuation against continuationGroup once every job in group has finished
+     *
+     * The continuation counts towards continuationGroup straight away, so waiting on that group also waits
+     * for it. If group has already finished the continuation is submitted immediately.
+     */
+    void then(TaskGroup& group, TaskGroup& continuationGroup, Job continuation) {
+        {
+            std::lock_guard lock { continuationGroup.m_mutex };
+            continuationGroup.m_pending++;
+        }
+
+        {
+            std::lock_guard lock { group.m_mutex };
+            if (group.m_pending > 0) {
+                group.m_continuation = std::move(continuation);
+                group.r_continuationGroup = &continuationGroup;
+                return;
+            }
+        }
+
+        push(continuationGroup, std::move(continuation));
+    }
+
+    // runs jobs until every job in the group has finished, then rethrows the first exception any of them threw
+    void wait(TaskGroup& group) {
+        while (!group.isDone())
+            if (!tryRunOne()) std::this_thread::yield();
+
+        std::exception_ptr exception;
+        std::swap(exception, group.m_exception);
+        if (exception) std::rethrow_exception(exception);
+    }
+
+    /**
+     * @brief Calls func(rangeBegin, rangeEnd) over sub-ranges of [begin, end) no larger than grainSize
+     *
+     * The range is split in half recursively, so idle workers steal large pieces first. Returns once the
+     * whole range has been processed.
+     */
+    template<typename Func>
+    void parallelFor(size_t begin, size_t end, size_t grainSize, Func&& func) {
+        if (begin >= end) return;
+        grainSize = std::max<size_t>(grainSize, 1);
+
+        TaskGroup group;
+
+        std::function<void(size_t, size_t)> split = [&](size_t rangeBegin, size_t rangeEnd) {
+            while (rangeEnd - rangeBegin > grainSize) {
+                size_t middle = rangeBegin + (rangeEnd - rangeBegin) / 2;
+                submit(group, [&split, middle, rangeEnd]{ split(middle, rangeEnd); });
+                rangeEnd = middle;
+            }
+
+            func(rangeBegin, rangeEnd);
+        };
+
+        try {
+            split(begin, end);
+        } catch (...) {
+            // the jobs already submitted still reference split and group
+            wait(group);
+            throw;
+        }
+
+        wait(group);
+    }
+};
+
+}
+
+#endif
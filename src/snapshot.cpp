@@ -0,0 +1,257 @@
+#include <snapshot.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#ifdef WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mge::ecs {
+
+namespace {
+
+constexpr char MAGIC[4] = { 'M', 'G', 'E', 'S' };
+constexpr size_t ALIGNMENT = 16;
+
+size_t align(size_t offset) { return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1); }
+
+// a read only view of a whole file, unmapped when it goes out of scope
+class MappedFile {
+    const std::byte* m_data = nullptr;
+    size_t m_size = 0;
+
+#ifdef WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#endif
+
+public:
+    MappedFile(const std::string& path) {
+#ifdef WIN32
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open snapshot '" + path + "'");
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(m_file, &size);
+        m_size = static_cast<size_t>(size.QuadPart);
+        if (m_size == 0) return;
+
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping) m_data = static_cast<const std::byte*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if (file == -1) throw std::runtime_error("Failed to open snapshot '" + path + "'");
+
+        struct stat status;
+        if (fstat(file, &status) == 0) m_size = static_cast<size_t>(status.st_size);
+
+        if (m_size > 0) {
+            void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (data != MAP_FAILED) m_data = static_cast<const std::byte*>(data);
+        }
+
+        // the mapping keeps its own reference to the file
+        close(file);
+#endif
+
+        if (m_size > 0 && !m_data) throw std::runtime_error("Failed to map snapshot '" + path + "'");
+    }
+
+    ~MappedFile() {
+#ifdef WIN32
+        if (m_data) UnmapViewOfFile(m_data);
+        if (m_mapping) CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+#else
+        if (m_data) munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const std::byte* data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
+// reads sections of a mapped file in order, checking that each one fits
+class Reader {
+    const MappedFile& r_file;
+    size_t m_offset = 0;
+
+public:
+    Reader(const MappedFile& file) : r_file(file) {}
+
+    const std::byte* take(size_t size) {
+        m_offset = align(m_offset);
+        if (m_offset > r_file.size() || size > r_file.size() - m_offset)
+            throw std::runtime_error("Snapshot is truncated");
+
+        const std::byte* result = r_file.data() + m_offset;
+        m_offset += size;
+        return result;
+    }
+
+    template<typename T>
+    T read() {
+        T result;
+        std::memcpy(&result, take(sizeof(T)), sizeof(T));
+        return result;
+    }
+};
+
+class Writer {
+    std::ofstream m_file;
+    size_t m_offset = 0;
+
+public:
+    Writer(const std::string& path) : m_file(path, std::ios::binary | std::ios::trunc) {
+        if (!m_file) throw std::runtime_error("Failed to open snapshot '" + path + "' for writing");
+    }
+
+    void write(const void* data, size_t size) {
+        static const char padding[ALIGNMENT] = {};
+        size_t aligned = align(m_offset);
+        m_file.write(padding, static_cast<std::streamsize>(aligned - m_offset));
+
+        m_file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        m_offset = aligned + size;
+    }
+
+    template<typename T>
+    void write(const T& value) { write(&value, sizeof(T)); }
+
+    void finish() {
+        m_file.flush();
+        if (!m_file) throw std::runtime_error("Failed to write snapshot");
+    }
+};
+
+}
+
+void Snapshot::save(const ECSManager& ecs, const std::string& path) {
+    std::vector<std::pair<const std::string*, const SystemBase*>> systems;
+    for (auto& [ name, system ] : ecs.m_systems)
+        if (system->isSnapshottable()) systems.push_back({ &name, system });
+
+    Header header {};
+    std::memcpy(header.m_magic, MAGIC, sizeof(MAGIC));
+    header.m_version = VERSION;
+    header.m_entityCount = static_cast<uint32_t>(ecs.m_generations.size());
+    header.m_freeCount = static_cast<uint32_t>(ecs.m_freeIndices.size());
+    header.m_blobCount = static_cast<uint32_t>(systems.size());
+
+    Writer writer(path);
+    writer.write(header);
+    writer.write(ecs.m_generations.data(), ecs.m_generations.size() * sizeof(uint32_t));
+    writer.write(ecs.m_freeIndices.data(), ecs.m_freeIndices.size() * sizeof(uint32_t));
+
+    for (auto [ name, system ] : systems) {
+        const auto& entities = system->getEntities();
+
+        BlobHeader blob {};
+        blob.m_nameLength = static_cast<uint32_t>(name->size());
+        blob.m_componentSize = static_cast<uint32_t>(system->getComponentSize());
+        blob.m_count = static_cast<uint32_t>(entities.size());
+
+        writer.write(blob);
+        writer.write(name->data(), name->size());
+        writer.write(entities.data(), entities.size() * sizeof(Entity));
+        writer.write(system->getComponentData(), entities.size() * system->getComponentSize());
+    }
+
+    writer.finish();
+}
+
+void Snapshot::load(ECSManager& ecs, const std::string& path) {
+    MappedFile file(path);
+    Reader reader(file);
+
+    auto header = reader.read<Header>();
+    if (std::memcmp(header.m_magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("'" + path + "' isn't an ECS snapshot");
+    if (header.m_version != VERSION)
+        throw std::runtime_error("Snapshot '" + path + "' is version " + std::to_string(header.m_version)
+            + ", expected " + std::to_string(VERSION));
+
+    auto generations = reinterpret_cast<const uint32_t*>(reader.take(header.m_entityCount * sizeof(uint32_t)));
+    auto freeIndices = reinterpret_cast<const uint32_t*>(reader.take(header.m_freeCount * sizeof(uint32_t)));
+
+    for (uint32_t i = 0; i < header.m_freeCount; i++)
+        if (freeIndices[i] >= header.m_entityCount) throw std::runtime_error("Snapshot's free list is corrupt");
+
+    struct Blob {
+        SystemBase* r_system;
+        std::span<const Entity> m_entities;
+        const void* m_components;
+    };
+
+    // validate the whole file before touching the world, so a bad snapshot leaves it as it was
+    std::vector<Blob> blobs;
+
+    // the last blob each entity was seen in, an entity listed twice in one would corrupt the system's sparse index
+    std::vector<uint32_t> seenIn(header.m_entityCount, ~0u);
+
+    for (uint32_t i = 0; i < header.m_blobCount; i++) {
+        auto blobHeader = reader.read<BlobHeader>();
+        auto nameData = reinterpret_cast<const char*>(reader.take(blobHeader.m_nameLength));
+        std::string name(nameData, blobHeader.m_nameLength);
+
+        auto it = ecs.m_systems.find(name);
+        if (it == ecs.m_systems.end())
+            throw std::runtime_error("Snapshot has components for system '" + name + "', which hasn't been added");
+
+        SystemBase* system = it->second;
+        if (!system->isSnapshottable() || system->getComponentSize() != blobHeader.m_componentSize)
+            throw std::runtime_error("Snapshot's components for system '" + name + "' don't match its component type");
+
+        auto entities = reinterpret_cast<const Entity*>(reader.take(size_t(blobHeader.m_count) * sizeof(Entity)));
+        auto components = reader.take(size_t(blobHeader.m_count) * blobHeader.m_componentSize);
+
+        for (uint32_t e = 0; e < blobHeader.m_count; e++) {
+            if (entities[e].m_index >= header.m_entityCount || generations[entities[e].m_index] != entities[e].m_generation)
+                throw std::runtime_error("Snapshot's components for system '" + name + "' belong to dead entities");
+
+            if (seenIn[entities[e].m_index] == i)
+                throw std::runtime_error("Snapshot's components for system '" + name + "' list an entity twice");
+            seenIn[entities[e].m_index] = i;
+        }
+
+        blobs.push_back({ system, { entities, blobHeader.m_count }, components });
+    }
+
+    // everything the snapshot doesn't cover is removed through the systems, so they can release resources
+    for (auto& [ name, system ] : ecs.m_systems) {
+        std::vector<Entity> entities = system->getEntities();
+        if (!entities.empty()) system->removeComponents(entities);
+    }
+
+    ecs.m_archetypes.clear();
+
+    ecs.m_generations.assign(generations, generations + header.m_entityCount);
+    ecs.m_freeIndices.assign(freeIndices, freeIndices + header.m_freeCount);
+    ecs.m_signatures.assign(header.m_entityCount, 0);
+
+    std::unordered_map<const SystemBase*, ComponentTypeID> typeIDs;
+    for (ComponentTypeID typeID = 0; typeID < ecs.m_systemsByType.size(); typeID++)
+        if (ecs.m_systemsByType[typeID]) typeIDs[ecs.m_systemsByType[typeID]] = typeID;
+
+    for (auto& blob : blobs) {
+        blob.r_system->loadComponents(blob.m_entities, blob.m_components);
+
+        Signature bit = Signature { 1 } << typeIDs.at(blob.r_system);
+        for (const auto& entity : blob.m_entities) ecs.m_signatures[entity.m_index] |= bit;
+    }
+}
+
+}